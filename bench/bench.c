@@ -0,0 +1,636 @@
+#include <getopt.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "demod.h"
+#include "dsp/nco.h"
+#include "synth.h"
+#include "utils.h"
+#include "wavfile.h"
+
+#define SHORTOPTS "Ac:CFghi:l:m:n:o:p:r:s:t:v"
+#define BLOCKSIZE 4096
+#define SAMPLERATE 230000
+#define SNR 10.0
+#define CARRIER_OFFSET 1000.0
+#define DRIFT 20.0
+#define DURATION 10.0
+#define LEAD_IN 1.0
+#define ITERATIONS 3
+#define SEED 0x1337
+
+/* A filter_get() call happening while processing a sample, as scheduled by the
+ * symbol clock. kind is 1 for intersamples, 2 for actual symbols (OQPSK), and
+ * always 2 for QPSK */
+struct event {
+	uint32_t sample;
+	uint8_t phase;
+	uint8_t kind;
+};
+
+struct params {
+	float samplerate;
+	float snr;
+	float carrier_offset;
+	float drift;
+	float duration;
+	float lead_in;
+	int iterations;
+	int fixed;
+	int cubic;
+	int gardner;
+	int pre_agc;
+};
+
+struct result {
+	double total, io, decim, filter, agc, pll, timing;  /* ns/sample */
+	double mix, mix_block;                              /* ns/sample, oscillator alone */
+	double lock_time;                                   /* Seconds after the signal starts, negative if never locked */
+	size_t symbols;
+};
+
+static int run_case(FILE *out, const struct params *p, int oqpsk, float symrate, int first);
+static void bench_demod(struct result *res, const struct params *p, const float complex *samples, const int16_t *raw, size_t count, int oqpsk, float symrate);
+static void measure_lock(struct result *res, const struct params *p, const float complex *samples, const int16_t *raw, size_t count, int oqpsk, float symrate);
+static int bench_stages(struct result *res, const struct params *p, const float complex *samples, size_t count, int oqpsk, float symrate);
+static void bench_mixer(struct result *res, const struct params *p, float complex *samples, size_t count);
+static Demod* create_demod(const struct params *p, int oqpsk, float symrate);
+static size_t schedule(struct event *events, Timing tim, int interp_factor, size_t count, int oqpsk);
+static void quantize(int16_t *dst, const float complex *src, size_t count);
+static void print_stage(FILE *out, const char *name, double value, int last);
+static double now(void);
+static void bench_usage(const char *pname);
+
+static struct option longopts[] = {
+	{ "pre-agc",    0, NULL, 'A' },
+	{ "carrier",    1, NULL, 'c' },
+	{ "cubic",      0, NULL, 'C' },
+	{ "fixed",      0, NULL, 'F' },
+	{ "gardner",    0, NULL, 'g' },
+	{ "help",       0, NULL, 'h' },
+	{ "iterations", 1, NULL, 'i' },
+	{ "lead-in",    1, NULL, 'l' },
+	{ "mode",       1, NULL, 'm' },
+	{ "snr",        1, NULL, 'n' },
+	{ "output",     1, NULL, 'o' },
+	{ "drift",      1, NULL, 'p' },
+	{ "symrate",    1, NULL, 'r' },
+	{ "samplerate", 1, NULL, 's' },
+	{ "duration",   1, NULL, 't' },
+	{ "version",    0, NULL, 'v' },
+	{ NULL,         0, NULL,  0  }
+};
+
+int
+main(int argc, char *argv[])
+{
+	const float symrates[] = {72000, 80000};
+	struct params p;
+	FILE *out;
+	int c, mode, oqpsk, ret, first;
+	unsigned i;
+	float symrate;
+
+	/* Command-line changeable parameters {{{ */
+	char *output_fname = NULL;
+	p.samplerate = SAMPLERATE;
+	p.snr = SNR;
+	p.carrier_offset = CARRIER_OFFSET;
+	p.drift = DRIFT;
+	p.duration = DURATION;
+	p.lead_in = LEAD_IN;
+	p.iterations = ITERATIONS;
+	p.fixed = 0;
+	p.cubic = 0;
+	p.gardner = 0;
+	p.pre_agc = 0;
+	mode = -1;          /* Both QPSK and OQPSK */
+	symrate = -1;       /* Both 72k and 80k */
+	/* }}} */
+	/* Parse command-line options {{{ */
+	while ((c = getopt_long(argc, argv, SHORTOPTS, longopts, NULL)) != -1) {
+		switch (c) {
+			case 'A':
+				p.pre_agc = 1;
+				break;
+			case 'c':
+				p.carrier_offset = human_to_float(optarg);
+				break;
+			case 'C':
+				p.cubic = 1;
+				break;
+			case 'F':
+				p.fixed = 1;
+				break;
+			case 'g':
+				p.gardner = 1;
+				break;
+			case 'h':
+				bench_usage(argv[0]);
+				return 0;
+			case 'i':
+				p.iterations = MAX(1, atoi(optarg));
+				break;
+			case 'l':
+				p.lead_in = MAX(0, atof(optarg));
+				break;
+			case 'm':
+				mode = !strcmp(optarg, "oqpsk");
+				break;
+			case 'n':
+				p.snr = atof(optarg);
+				break;
+			case 'o':
+				output_fname = optarg;
+				break;
+			case 'p':
+				p.drift = atof(optarg);
+				break;
+			case 'r':
+				symrate = human_to_float(optarg);
+				break;
+			case 's':
+				p.samplerate = human_to_float(optarg);
+				break;
+			case 't':
+				p.duration = atof(optarg);
+				break;
+			case 'v':
+				version();
+				return 0;
+			default:
+				bench_usage(argv[0]);
+				return 1;
+		}
+	}
+	/* }}} */
+
+	if (p.fixed && p.cubic) {
+		fprintf(stderr, "The cubic interpolator is not available on the fixed-point path\n");
+		return 1;
+	}
+	if (p.gardner && (p.fixed || p.cubic)) {
+		fprintf(stderr, "The Gardner detector is only available on the floating point polyphase path\n");
+		return 1;
+	}
+
+	if (!output_fname) {
+		out = stdout;
+	} else if (!(out = fopen(output_fname, "w"))) {
+		fprintf(stderr, "Could not open output file\n");
+		return 1;
+	}
+
+	fprintf(out, "{\n");
+	fprintf(out, "  \"version\": \"%s\",\n", VERSION);
+	fprintf(out, "  \"samplerate\": %.0f,\n", p.samplerate);
+	fprintf(out, "  \"snr_db\": %.2f,\n", p.snr);
+	fprintf(out, "  \"carrier_offset_hz\": %.2f,\n", p.carrier_offset);
+	fprintf(out, "  \"drift_ppm\": %.2f,\n", p.drift);
+	fprintf(out, "  \"duration_s\": %.2f,\n", p.duration);
+	fprintf(out, "  \"lead_in_s\": %.2f,\n", p.lead_in);
+	fprintf(out, "  \"iterations\": %d,\n", p.iterations);
+	fprintf(out, "  \"fixed\": %s,\n", p.fixed ? "true" : "false");
+	fprintf(out, "  \"cubic\": %s,\n", p.cubic ? "true" : "false");
+	fprintf(out, "  \"ted\": \"%s\",\n", p.gardner ? "gardner" : "mm");
+	fprintf(out, "  \"pre_agc\": %s,\n", p.pre_agc ? "true" : "false");
+	fprintf(out, "  \"cases\": [");
+
+	ret = 0;
+	first = 1;
+	for (oqpsk=0; oqpsk<2 && !ret; oqpsk++) {
+		if (mode >= 0 && mode != oqpsk) continue;
+
+		for (i=0; i<LEN(symrates) && !ret; i++) {
+			if (symrate > 0 && i > 0) break;
+			ret = run_case(out, &p, oqpsk, symrate > 0 ? symrate : symrates[i], first);
+			first = 0;
+		}
+	}
+
+	fprintf(out, "\n  ]\n}\n");
+	if (out != stdout) fclose(out);
+
+	return ret;
+}
+
+/* Static functions {{{ */
+/**
+ * Generate a signal, benchmark the demodulator against it and write the
+ * results as a JSON object
+ */
+static int
+run_case(FILE *out, const struct params *p, int oqpsk, float symrate, int first)
+{
+	const size_t count = (p->lead_in + p->duration) * p->samplerate;
+	float complex *samples;
+	int16_t *raw;
+	Synth *syn;
+	struct result res;
+	double start;
+	int i;
+
+	fprintf(stderr, "%s @ %.0f sym/s: generating signal...\n", oqpsk ? "OQPSK" : "QPSK", symrate);
+
+	samples = malloc(sizeof(*samples) * count);
+	raw = malloc(sizeof(*raw) * 2 * count);
+	syn = malloc(sizeof(*syn));
+	if (!samples || !raw || !syn) {
+		fprintf(stderr, "Could not allocate %lu samples\n", (unsigned long)count);
+		free(samples);
+		free(raw);
+		free(syn);
+		return 1;
+	}
+
+	/* Generate the signal and store it as 16-bit integers, which is what most
+	 * recordings look like. The I/O stage converts it back */
+	synth_init(syn, p->samplerate, symrate, oqpsk, p->snr, p->carrier_offset, p->drift, p->lead_in, SEED);
+	synth_generate(syn, samples, count);
+	quantize(raw, samples, count);
+	free(syn);
+
+	memset(&res, 0, sizeof(res));
+	res.io = INFINITY;
+	for (i=0; i<p->iterations; i++) {
+		start = now();
+		wav_convert(samples, raw, count, 16);
+		res.io = MIN(res.io, (now() - start) * 1e9 / count);
+	}
+
+	/* The fixed-point path reads 16-bit samples as they are */
+	if (p->fixed) res.io = 0;
+
+	fprintf(stderr, "%s @ %.0f sym/s: benchmarking...\n", oqpsk ? "OQPSK" : "QPSK", symrate);
+	bench_demod(&res, p, samples, raw, count, oqpsk, symrate);
+	measure_lock(&res, p, samples, raw, count, oqpsk, symrate);
+	free(raw);
+
+	/* Individual stages are only instrumented for the floating point,
+	 * polyphase path with the M&M detector and without the pre-filter AGC */
+	if (p->fixed || p->cubic || p->gardner || p->pre_agc) {
+		res.decim = res.filter = res.agc = res.pll = res.timing = NAN;
+	} else if (bench_stages(&res, p, samples, count, oqpsk, symrate)) {
+		fprintf(stderr, "Could not initialize demodulator\n");
+		free(samples);
+		return 1;
+	}
+
+	/* Last, since it overwrites the signal */
+	bench_mixer(&res, p, samples, count);
+	free(samples);
+
+	res.total += res.io;
+
+	fprintf(out, "%s\n    {\n", first ? "" : ",");
+	fprintf(out, "      \"mode\": \"%s\",\n", oqpsk ? "oqpsk" : "qpsk");
+	fprintf(out, "      \"symrate\": %.0f,\n", symrate);
+	fprintf(out, "      \"samples\": %lu,\n", (unsigned long)count);
+	fprintf(out, "      \"symbols\": %lu,\n", (unsigned long)res.symbols);
+	fprintf(out, "      \"msps\": %.3f,\n", 1e3 / res.total);
+	fprintf(out, "      \"ns_per_sample\": {\n");
+	print_stage(out, "total", res.total, 0);
+	print_stage(out, "io", res.io, 0);
+	print_stage(out, "decim", res.decim, 0);
+	print_stage(out, "filter", res.filter, 0);
+	print_stage(out, "agc", res.agc, 0);
+	print_stage(out, "pll", res.pll, 0);
+	print_stage(out, "timing", res.timing, 1);
+	fprintf(out, "      },\n");
+	fprintf(out, "      \"nco_ns_per_sample\": {\n");
+	print_stage(out, "scalar", res.mix, 0);
+	print_stage(out, "block", res.mix_block, 1);
+	fprintf(out, "      },\n");
+	if (res.lock_time >= 0) {
+		fprintf(out, "      \"time_to_lock_s\": %.4f\n", res.lock_time);
+	} else {
+		fprintf(out, "      \"time_to_lock_s\": null\n");
+	}
+	fprintf(out, "    }");
+	fflush(out);
+
+	return 0;
+}
+
+/**
+ * Run the complete demodulator on the signal, measuring throughput
+ */
+static void
+bench_demod(struct result *res, const struct params *p, const float complex *samples, const int16_t *raw, size_t count, int oqpsk, float symrate)
+{
+	size_t (*demod)(Demod*, float complex*, const float complex*, size_t);
+	size_t (*demod_s16)(Demod*, float complex*, const int16_t*, size_t);
+	float complex *symbols;
+	Demod *dem;
+	double start, elapsed;
+	size_t n, chunk, produced;
+	int i;
+
+	demod = oqpsk ? demod_oqpsk_block : demod_qpsk_block;
+	demod_s16 = oqpsk ? demod_oqpsk_block_s16 : demod_qpsk_block_s16;
+	if (!(symbols = malloc(sizeof(*symbols) * BLOCKSIZE))) return;
+
+	res->total = INFINITY;
+	for (i=0; i<p->iterations; i++) {
+		if (!(dem = create_demod(p, oqpsk, symrate))) break;
+
+		produced = 0;
+		start = now();
+		for (n=0; n<count; n += chunk) {
+			chunk = MIN(BLOCKSIZE, count - n);
+			if (p->fixed) {
+				produced += demod_s16(dem, symbols, raw + 2*n, chunk);
+			} else {
+				produced += demod(dem, symbols, samples + n, chunk);
+			}
+		}
+		elapsed = now() - start;
+
+		res->total = MIN(res->total, elapsed * 1e9 / count);
+		res->symbols = produced;
+		demod_deinit(dem);
+	}
+
+	free(symbols);
+}
+
+/**
+ * Find out how long it takes for the carrier loop to lock once the signal
+ * starts. The samples are fed one at a time, so that the lock point is known
+ * down to the symbol rather than to the block
+ */
+static void
+measure_lock(struct result *res, const struct params *p, const float complex *samples, const int16_t *raw, size_t count, int oqpsk, float symrate)
+{
+	const size_t start = p->lead_in * p->samplerate;
+	float complex symbol[2];        /* A sample yields one symbol at most */
+	Demod *dem;
+	size_t n;
+
+	res->lock_time = -1;
+	if (!(dem = create_demod(p, oqpsk, symrate))) return;
+
+	for (n=0; n<count; n++) {
+		if (p->fixed) {
+			oqpsk ? demod_oqpsk_block_s16(dem, symbol, raw + 2*n, 1) : demod_qpsk_block_s16(dem, symbol, raw + 2*n, 1);
+		} else {
+			oqpsk ? demod_oqpsk_block(dem, symbol, samples + n, 1) : demod_qpsk_block(dem, symbol, samples + n, 1);
+		}
+
+		/* Locking onto the noise doesn't count */
+		if (n >= start && pll_get_locked(&dem->pll)) {
+			res->lock_time = (double)(n + 1 - start) / p->samplerate;
+			break;
+		}
+	}
+
+	demod_deinit(dem);
+}
+
+/**
+ * Time each stage of the demodulator in isolation, calling it as many times as
+ * the complete demodulator would. All results are normalized to the input
+ * sample rate, so that they add up to (roughly) the total processing time
+ */
+static int
+bench_stages(struct result *res, const struct params *p, const float complex *samples, size_t count, int oqpsk, float symrate)
+{
+	float complex *decimated, *filtered, *normalized, *mixed;
+	struct event *events;
+	size_t n, n_dec, n_events, max_events, e, chunk, steps, step, skip;
+	double start;
+	Demod *dem;
+	float quad;
+	int i, kind, interp_factor;
+
+	if (!(dem = create_demod(p, oqpsk, symrate))) return 1;
+	interp_factor = dem->rrc.interp_factor;
+
+	decimated = malloc(sizeof(*decimated) * count);
+	/* There can be up to one event per polyphase branch per sample */
+	max_events = count * interp_factor;
+	events = malloc(sizeof(*events) * max_events);
+	filtered = malloc(sizeof(*filtered) * max_events);
+	normalized = malloc(sizeof(*normalized) * max_events);
+	mixed = malloc(sizeof(*mixed) * max_events);
+	if (!decimated || !events || !filtered || !normalized || !mixed) {
+		free(decimated);
+		free(events);
+		free(filtered);
+		free(normalized);
+		free(mixed);
+		demod_deinit(dem);
+		return 1;
+	}
+
+	res->decim = res->filter = res->agc = res->pll = res->timing = INFINITY;
+	for (i=0; i<p->iterations; i++) {
+		/* Decimation */
+		n_dec = 0;
+		start = now();
+		if (dem->decim.count) {
+			for (n=0; n<count; n += chunk) {
+				chunk = MIN(BLOCKSIZE, count - n);
+				n_dec += decim_process(&dem->decim, decimated + n_dec, samples + n, chunk);
+			}
+		} else {
+			memcpy(decimated, samples, sizeof(*samples) * count);
+			n_dec = count;
+		}
+		res->decim = dem->decim.count ? MIN(res->decim, (now() - start) * 1e9 / count) : 0;
+
+		/* Find out when filter_get() would be called, assuming a perfect
+		 * symbol clock */
+		n_events = schedule(events, dem->timing, interp_factor, n_dec, oqpsk);
+
+		/* RRC filter */
+		start = now();
+		for (n=0, e=0; n<n_dec; n++) {
+			filter_fwd_sample(&dem->rrc, decimated[n]);
+			for (; e<n_events && events[e].sample == n; e++) {
+				filtered[e] = filter_get(&dem->rrc, events[e].phase);
+			}
+		}
+		res->filter = MIN(res->filter, (now() - start) * 1e9 / count);
+
+		/* AGC */
+		start = now();
+		for (e=0; e<n_events; e++) {
+			normalized[e] = agc_apply(&dem->agc, filtered[e]);
+		}
+		res->agc = MIN(res->agc, (now() - start) * 1e9 / count);
+
+		/* Carrier recovery */
+		start = now();
+		if (oqpsk) {
+			for (e=0; e<n_events; e++) {
+				if (events[e].kind == 1) {
+					dem->inphase = pll_mix_i(&dem->pll, normalized[e]);
+				} else {
+					quad = pll_mix_q(&dem->pll, normalized[e]);
+					mixed[e] = dem->inphase + I*quad;
+					pll_update_estimate(&dem->pll, dem->inphase, quad);
+				}
+			}
+		} else {
+			for (e=0; e<n_events; e++) {
+				mixed[e] = pll_mix(&dem->pll, normalized[e]);
+				pll_update_estimate(&dem->pll, crealf(mixed[e]), cimagf(mixed[e]));
+			}
+		}
+		res->pll = MIN(res->pll, (now() - start) * 1e9 / count);
+
+		/* Symbol clock recovery */
+		start = now();
+		steps = n_dec * interp_factor;
+		for (step=0, e=0; (skip = oqpsk ? skip_to_timeslot_dual(&dem->timing, steps - step, &kind)
+		                                 : skip_to_timeslot(&dem->timing, steps - step)); e++) {
+			step += skip;
+			if (e < n_events && events[e].kind == 2) retime(&dem->timing, mixed[e]);
+		}
+		res->timing = MIN(res->timing, (now() - start) * 1e9 / count);
+	}
+
+	free(decimated);
+	free(events);
+	free(filtered);
+	free(normalized);
+	free(mixed);
+	demod_deinit(dem);
+	return 0;
+}
+
+/**
+ * Time the oscillator alone, mixing the signal at a fixed frequency one sample
+ * at a time and one block at a time. The signal is mixed in place
+ */
+static void
+bench_mixer(struct result *res, const struct params *p, float complex *samples, size_t count)
+{
+	const float freq = 2*M_PI*p->carrier_offset / p->samplerate;
+	Nco nco;
+	double start;
+	size_t n;
+	int i;
+
+	res->mix = res->mix_block = INFINITY;
+	for (i=0; i<p->iterations; i++) {
+		nco_init(&nco, freq);
+		start = now();
+		for (n=0; n<count; n++) {
+			samples[n] = nco_mix(&nco, samples[n]);
+		}
+		res->mix = MIN(res->mix, (now() - start) * 1e9 / count);
+
+		nco_init(&nco, freq);
+		start = now();
+		for (n=0; n<count; n += BLOCKSIZE) {
+			nco_mix_block(&nco, samples + n, samples + n, MIN(BLOCKSIZE, count - n));
+		}
+		res->mix_block = MIN(res->mix_block, (now() - start) * 1e9 / count);
+	}
+}
+
+static Demod*
+create_demod(const struct params *p, int oqpsk, float symrate)
+{
+	return demod_init(PLL_BW, SYM_BW, p->samplerate, symrate, p->cubic ? 1 : INTERP_FACTOR, RRC_ORDER,
+	                  oqpsk, -1, -1, 1, p->fixed, p->cubic, p->gardner, p->pre_agc);
+}
+
+/**
+ * Run a copy of the symbol clock without any feedback, recording the sample
+ * index and polyphase branch of every filter output it asks for
+ */
+static size_t
+schedule(struct event *events, Timing tim, int interp_factor, size_t count, int oqpsk)
+{
+	const size_t steps = count * interp_factor;
+	size_t step, skip, n_events;
+	int kind;
+
+	n_events = 0;
+	kind = 2;
+	for (step=0; (skip = oqpsk ? skip_to_timeslot_dual(&tim, steps - step, &kind) : skip_to_timeslot(&tim, steps - step)); ) {
+		step += skip;
+
+		events[n_events].sample = (step - 1) / interp_factor;
+		events[n_events].phase = (step - 1) % interp_factor;
+		events[n_events].kind = kind;
+		n_events++;
+
+		/* Same phase adjustment retime() does, minus the error term */
+		if (kind == 2) tim.phase -= 2*M_PI;
+	}
+
+	return n_events;
+}
+
+/* Scale a signal to use most of the 16-bit range, and convert it to interleaved
+ * integer I/Q */
+static void
+quantize(int16_t *dst, const float complex *src, size_t count)
+{
+	float peak, scale;
+	size_t i;
+
+	peak = 0;
+	for (i=0; i<count; i++) {
+		peak = MAX(peak, MAX(fabsf(crealf(src[i])), fabsf(cimagf(src[i]))));
+	}
+	scale = peak > 0 ? 32000 / peak : 1;
+
+	for (i=0; i<count; i++) {
+		dst[2*i]   = lrintf(crealf(src[i]) * scale);
+		dst[2*i+1] = lrintf(cimagf(src[i]) * scale);
+	}
+}
+
+/* Write a ns/sample figure as a JSON member, null if it was not measured */
+static void
+print_stage(FILE *out, const char *name, double value, int last)
+{
+	if (isnan(value)) {
+		fprintf(out, "        \"%s\": null%s\n", name, last ? "" : ",");
+	} else {
+		fprintf(out, "        \"%s\": %.3f%s\n", name, value, last ? "" : ",");
+	}
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void
+bench_usage(const char *pname)
+{
+	fprintf(stderr, "Usage: %s [options]\n", pname);
+	fprintf(stderr,
+	        "   -A, --pre-agc           Enable the pre-filter AGC\n"
+	        "   -c, --carrier <hz>      Set the carrier offset to <hz> (default: %.0f)\n"
+	        "   -C, --cubic             Benchmark the cubic timing interpolator instead of the polyphase filter\n"
+	        "   -F, --fixed             Benchmark the 16-bit fixed-point signal path\n"
+	        "   -g, --gardner           Benchmark the Gardner timing error detector instead of M&M\n"
+	        "   -i, --iterations <n>    Repeat each measurement <n> times, keeping the best (default: %d)\n"
+	        "   -l, --lead-in <secs>    Start the signal after <secs> seconds of noise (default: %.0f)\n"
+	        "   -m, --mode <mode>       Only benchmark <mode> (default: both, valid modes: qpsk, oqpsk)\n"
+	        "   -n, --snr <db>          Set the in-band signal to noise ratio to <db> (default: %.0f)\n"
+	        "   -o, --output <file>     Write the JSON results to <file> (default: stdout)\n"
+	        "   -p, --drift <ppm>       Set the symbol clock error to <ppm> (default: %.0f)\n"
+	        "   -r, --symrate <rate>    Only benchmark symbol rate <rate> (default: both 72000 and 80000)\n"
+	        "   -s, --samplerate <samp> Set the sample rate to <samp> (default: %d)\n"
+	        "   -t, --duration <secs>   Generate <secs> seconds of signal (default: %.0f)\n"
+	        "\n"
+	        "   -h, --help              Print this help screen\n"
+	        "   -v, --version           Print version info\n",
+	        CARRIER_OFFSET, ITERATIONS, LEAD_IN, SNR, DRIFT, SAMPLERATE, DURATION);
+}
+/* }}} */
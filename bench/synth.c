@@ -0,0 +1,169 @@
+#include <complex.h>
+#include <math.h>
+#include "demod.h"
+#include "synth.h"
+#include "utils.h"
+
+static float rrc_pulse(float t, float alpha);
+static float complex symbol_at(Synth *syn, long k);
+static float pulse_at(const Synth *syn, double t);
+static uint32_t xorshift32(uint32_t *state);
+static float uniform(uint32_t *state);
+static float gaussian(uint32_t *state);
+
+void
+synth_init(Synth *syn, float samplerate, float symrate, int oqpsk, float snr, float freq_offset, float drift, float lead_in, uint32_t seed)
+{
+	float energy, sps, phase;
+	int i;
+
+	/* Tabulate the pulse shape, normalized to unit energy per symbol */
+	energy = 0;
+	for (i=0; i<(int)LEN(syn->pulse); i++) {
+		syn->pulse[i] = rrc_pulse((float)(i - SYNTH_SPAN*SYNTH_RES) / SYNTH_RES, RRC_ALPHA);
+		energy += syn->pulse[i] * syn->pulse[i];
+	}
+	energy /= SYNTH_RES;
+	for (i=0; i<(int)LEN(syn->pulse); i++) {
+		syn->pulse[i] /= sqrtf(energy);
+	}
+
+	/* Each symbol component has unit power, so the average signal power is 2.
+	 * Noise is white across the whole sample rate, so scale it up by the
+	 * number of samples per symbol to get the requested SNR in-band */
+	sps = samplerate / symrate;
+	syn->noise_std = sqrtf(2 * sps / powf(10, snr/10) / 2);
+
+	syn->rng = seed ? seed : 1;
+	syn->oqpsk = oqpsk;
+	syn->sym_time = 0;
+	syn->sym_step = symrate * (1 + drift*1e-6) / samplerate;
+	phase = 2*M_PI*uniform(&syn->rng);
+	nco_init(&syn->carrier, -2*M_PI*freq_offset / samplerate);
+	syn->carrier.phasor = cosf(phase) - I*sinf(phase);
+
+	syn->lead_in = lead_in * samplerate;
+	syn->last_symbol = -1;
+}
+
+void
+synth_generate(Synth *syn, float complex *dst, size_t count)
+{
+	const double offset = syn->oqpsk ? 0.5 : 0;
+	float complex sample;
+	float re, im;
+	double t;
+	long k, center;
+	size_t n;
+
+	for (n=0; n<count; n++) {
+		if (syn->lead_in) {
+			syn->lead_in--;
+			dst[n] = 0;
+			continue;
+		}
+
+		/* Sum the contributions of all the symbols whose pulses overlap the
+		 * current instant. In OQPSK mode the Q branch lags by half a symbol */
+		t = syn->sym_time;
+		center = (long)floor(t);
+		re = im = 0;
+		for (k=center-SYNTH_SPAN+1; k<=center+SYNTH_SPAN; k++) {
+			sample = symbol_at(syn, k);
+			re += crealf(sample) * pulse_at(syn, t - k);
+			im += cimagf(sample) * pulse_at(syn, t - k - offset);
+		}
+
+		dst[n] = re + I*im;
+		syn->sym_time += syn->sym_step;
+	}
+
+	/* The oscillator mixes with e^(-j*phase), so it runs backwards from the
+	 * carrier to shift the signal up by freq_offset */
+	nco_mix_block(&syn->carrier, dst, dst, count);
+
+	for (n=0; n<count; n++) {
+		dst[n] += syn->noise_std * (gaussian(&syn->rng) + I*gaussian(&syn->rng));
+	}
+}
+
+/* Static functions {{{ */
+/* Closed-form root raised cosine impulse response, t in symbols */
+static float
+rrc_pulse(float t, float alpha)
+{
+	const float singular = 1 / (4*alpha);
+
+	if (fabsf(t) < 1e-6) {
+		return 1 - alpha + 4*alpha/M_PI;
+	}
+	if (fabsf(fabsf(t) - singular) < 1e-6) {
+		return alpha/sqrtf(2) * ((1+2/M_PI)*sinf(M_PI/(4*alpha)) + (1-2/M_PI)*cosf(M_PI/(4*alpha)));
+	}
+
+	return (sinf(M_PI*t*(1-alpha)) + 4*alpha*t*cosf(M_PI*t*(1+alpha)))
+	     / (M_PI*t*(1 - (4*alpha*t)*(4*alpha*t)));
+}
+
+/* Get symbol #k, generating new random symbols as needed. Only the most recent
+ * LEN(symbols) symbols are kept around */
+static float complex
+symbol_at(Synth *syn, long k)
+{
+	const long len = LEN(syn->symbols);
+	uint32_t bits;
+
+	while (syn->last_symbol < k) {
+		syn->last_symbol++;
+		bits = xorshift32(&syn->rng);
+		syn->symbols[syn->last_symbol % len] = ((bits & 1) ? 1 : -1) + I*((bits & 2) ? 1 : -1);
+	}
+
+	if (k < 0 || k <= syn->last_symbol - len) return 0;
+	return syn->symbols[k % len];
+}
+
+/* Linearly interpolate the pulse table, t in symbols */
+static float
+pulse_at(const Synth *syn, double t)
+{
+	double pos;
+	int idx;
+
+	pos = (t + SYNTH_SPAN) * SYNTH_RES;
+	if (pos < 0 || pos >= LEN(syn->pulse) - 1) return 0;
+
+	idx = (int)pos;
+	return syn->pulse[idx] + (pos - idx) * (syn->pulse[idx+1] - syn->pulse[idx]);
+}
+
+static uint32_t
+xorshift32(uint32_t *state)
+{
+	uint32_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+
+	return *state = x;
+}
+
+static float
+uniform(uint32_t *state)
+{
+	return (xorshift32(state) >> 8) / (float)(1 << 24);
+}
+
+static float
+gaussian(uint32_t *state)
+{
+	float u, v;
+
+	/* Box-Muller, discarding the second value */
+	u = uniform(state);
+	v = uniform(state);
+
+	return sqrtf(-2 * logf(1 - u)) * cosf(2*M_PI*v);
+}
+/* }}} */
@@ -0,0 +1,47 @@
+#ifndef synth_h
+#define synth_h
+#include <complex.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "dsp/nco.h"
+
+#define SYNTH_SPAN 8        /* Pulse shaping filter half-length, in symbols */
+#define SYNTH_RES 256       /* Pulse shaping table resolution, in points per symbol */
+
+typedef struct {
+	float pulse[2*SYNTH_SPAN*SYNTH_RES + 1];
+	float complex symbols[4*SYNTH_SPAN];    /* Symbols around the current one */
+	long last_symbol;                       /* Index of the newest symbol in the history */
+	int oqpsk;
+	double sym_time, sym_step;              /* Time in symbols, and symbols per sample */
+	Nco carrier;                            /* Conjugate of the carrier, see synth_generate() */
+	size_t lead_in;                         /* Noise-only samples left before the signal starts */
+	float noise_std;
+	uint32_t rng;
+} Synth;
+
+/**
+ * Initialize a synthetic signal generator
+ *
+ * @param syn generator object to initialize
+ * @param samplerate sample rate of the generated signal
+ * @param symrate nominal symbol rate of the generated signal
+ * @param oqpsk 0 to generate a QPSK signal, 1 for OQPSK
+ * @param snr signal to noise ratio within the symbol bandwidth, in dB
+ * @param freq_offset carrier offset from the center frequency, in Hz
+ * @param drift symbol clock error, in ppm of the nominal symbol rate
+ * @param lead_in seconds of noise before the signal starts
+ * @param seed random number generator seed (must be nonzero)
+ */
+void synth_init(Synth *syn, float samplerate, float symrate, int oqpsk, float snr, float freq_offset, float drift, float lead_in, uint32_t seed);
+
+/**
+ * Generate the next block of samples
+ *
+ * @param syn generator to use
+ * @param dst buffer to write the samples to
+ * @param count number of samples to generate
+ */
+void synth_generate(Synth *syn, float complex *dst, size_t count);
+
+#endif
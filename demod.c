@@ -1,91 +1,485 @@
 #include <complex.h>
 #include <math.h>
+#include <stdlib.h>
 #include "demod.h"
+#include "utils.h"
 
-static Filter _rrc_filter;
+/* Fraction of the sample rate occupied by the signal that the decimator must
+ * preserve, relative to the nominal RRC bandwidth. Leaves some room for the
+ * carrier offset */
+#define DECIM_MARGIN 1.1
+#define DECIM_BLOCKSIZE 4096
 
-void
-demod_init(float pll_bw, float sym_bw, int samplerate, int symrate, int interp_factor, int rrc_order, int oqpsk, float freq_max)
+/* Set of demodulation loops sharing the same specialization */
+struct demod_loops {
+	int interp_factor;      /* 0 for the generic loops */
+	size_t (*qpsk)(Demod *dem, float complex *restrict dst, const float complex *restrict src, size_t count);
+	size_t (*oqpsk)(Demod *dem, float complex *restrict dst, const float complex *restrict src, size_t count);
+	size_t (*qpsk_s16)(Demod *dem, float complex *restrict dst, const int16_t *restrict src, size_t count);
+	size_t (*oqpsk_s16)(Demod *dem, float complex *restrict dst, const int16_t *restrict src, size_t count);
+};
+
+static const struct demod_loops* select_loops(int interp_factor, int cubic, int gardner);
+static size_t qpsk_loop_cubic(Demod *dem, float complex *restrict dst, const float complex *restrict src, size_t count);
+static size_t oqpsk_loop_cubic(Demod *dem, float complex *restrict dst, const float complex *restrict src, size_t count);
+static void acquire(Demod *dem, float complex sample);
+static float complex to_float(cint32 sample);
+static size_t decimate_and_demod(Demod *dem, float complex *dst, const float complex *src, size_t count,
+                                 size_t (*loop)(Demod*, float complex*, const float complex*, size_t));
+static size_t decimate_and_demod_s16(Demod *dem, float complex *dst, const int16_t *src, size_t count,
+                                     size_t (*loop)(Demod*, float complex*, const int16_t*, size_t));
+static size_t scale_and_demod(Demod *dem, float complex *dst, const float complex *src, size_t count,
+                              size_t (*loop)(Demod*, float complex*, const float complex*, size_t));
+static size_t scale_and_demod_s16(Demod *dem, float complex *dst, const int16_t *src, size_t count,
+                                  size_t (*loop)(Demod*, float complex*, const int16_t*, size_t));
+
+Demod*
+demod_init(float pll_bw, float sym_bw, int samplerate, int symrate, int interp_factor, int rrc_order, int oqpsk, float freq_max, int decim, int acq, int fixed, int cubic, int gardner, int pre_agc)
 {
+	const float passband = DECIM_MARGIN * symrate * (1 + RRC_ALPHA) / 2 / samplerate;
 	const int multiplier = oqpsk ? 1 : 2;   /* OQPSK uses two samples per symbol */
+	Demod *dem;
+	float rate;
+
+	if (cubic && (fixed || interp_factor != 1)) return NULL;
+	if (gardner && (fixed || cubic)) return NULL;
+	if (!(dem = calloc(1, sizeof(*dem)))) return NULL;
 
-	pll_init(2*M_PI*pll_bw/(multiplier * symrate), oqpsk, freq_max);
-	timing_init(2*M_PI*symrate/(samplerate*interp_factor), sym_bw/interp_factor);
-	filter_init_rrc(&_rrc_filter, rrc_order, (float)samplerate/symrate, RRC_ALPHA, interp_factor);
+	/* Automatically pick the number of decimation stages: decimate for as long
+	 * as there are at least DECIM_MIN_SPS samples per symbol left */
+	if (decim < 0) {
+		for (decim=0; samplerate / (float)(1 << (decim+1)) >= DECIM_MIN_SPS * symrate; decim++)
+			;
+	}
+	rate = (float)samplerate / (1 << decim);
+
+	if (fixed) {
+		if (qdecim_init(&dem->qdecim, decim, passband)) {
+			demod_deinit(dem);
+			return NULL;
+		}
+		if (decim > 0 && !(dem->qdecim_buf = malloc(sizeof(*dem->qdecim_buf) * 2 * (DECIM_BLOCKSIZE/2 + 1)))) {
+			demod_deinit(dem);
+			return NULL;
+		}
+		if (qfilter_init_rrc(&dem->qrrc, rrc_order, rate/symrate, RRC_ALPHA, interp_factor)) {
+			demod_deinit(dem);
+			return NULL;
+		}
+	} else {
+		if (decim_init(&dem->decim, decim, passband)) {
+			demod_deinit(dem);
+			return NULL;
+		}
+		if (decim > 0 && !(dem->decim_buf = malloc(sizeof(*dem->decim_buf) * (DECIM_BLOCKSIZE/2 + 1)))) {
+			demod_deinit(dem);
+			return NULL;
+		}
+		if (filter_init_rrc(&dem->rrc, rrc_order, rate/symrate, RRC_ALPHA, interp_factor)) {
+			demod_deinit(dem);
+			return NULL;
+		}
+	}
+	if (pre_agc) {
+		if (fixed) {
+			dem->qpreagc_buf = malloc(sizeof(*dem->qpreagc_buf) * 2 * DECIM_BLOCKSIZE);
+		} else {
+			dem->preagc_buf = malloc(sizeof(*dem->preagc_buf) * DECIM_BLOCKSIZE);
+		}
+		if (!dem->qpreagc_buf && !dem->preagc_buf) {
+			demod_deinit(dem);
+			return NULL;
+		}
+	}
+	if (acq && acq_init(&dem->acq, ACQ_LEN)) {
+		demod_deinit(dem);
+		return NULL;
+	}
+	agc_init(&dem->agc);
+	qagc_init(&dem->qagc);
+	preagc_init(&dem->preagc);
+	pll_init(&dem->pll, 2*M_PI*pll_bw/(multiplier * symrate), oqpsk, freq_max, fixed);
+	dem->pll.sweep = !acq;  /* Acquisition replaces the slow frequency sweep */
+	timing_init(&dem->timing, 2*M_PI*symrate/(rate*interp_factor), sym_bw/interp_factor);
+	farrow_init(&dem->farrow);
+	dem->loops = select_loops(interp_factor, cubic, gardner);
+	dem->oqpsk = oqpsk;
+	dem->fixed = fixed;
+	dem->pre_agc = pre_agc;
+	dem->samplerate = rate;
+	dem->symrate = symrate;
+
+	return dem;
 }
 
 void
-demod_deinit()
+demod_deinit(Demod *dem)
+{
+	decim_deinit(&dem->decim);
+	filter_deinit(&dem->rrc);
+	qdecim_deinit(&dem->qdecim);
+	qfilter_deinit(&dem->qrrc);
+	acq_deinit(&dem->acq);
+	free(dem->decim_buf);
+	free(dem->qdecim_buf);
+	free(dem->preagc_buf);
+	free(dem->qpreagc_buf);
+	free(dem);
+}
+
+size_t
+demod_qpsk_block(Demod *dem, float complex *dst, const float complex *src, size_t count)
+{
+	if (dem->pre_agc) return scale_and_demod(dem, dst, src, count, dem->loops->qpsk);
+	if (dem->decim.count) return decimate_and_demod(dem, dst, src, count, dem->loops->qpsk);
+	return dem->loops->qpsk(dem, dst, src, count);
+}
+
+size_t
+demod_oqpsk_block(Demod *dem, float complex *dst, const float complex *src, size_t count)
+{
+	if (dem->pre_agc) return scale_and_demod(dem, dst, src, count, dem->loops->oqpsk);
+	if (dem->decim.count) return decimate_and_demod(dem, dst, src, count, dem->loops->oqpsk);
+	return dem->loops->oqpsk(dem, dst, src, count);
+}
+
+size_t
+demod_qpsk_block_s16(Demod *dem, float complex *dst, const int16_t *src, size_t count)
 {
-	filter_deinit(&_rrc_filter);
+	if (dem->pre_agc) return scale_and_demod_s16(dem, dst, src, count, dem->loops->qpsk_s16);
+	if (dem->qdecim.count) return decimate_and_demod_s16(dem, dst, src, count, dem->loops->qpsk_s16);
+	return dem->loops->qpsk_s16(dem, dst, src, count);
+}
+
+size_t
+demod_oqpsk_block_s16(Demod *dem, float complex *dst, const int16_t *src, size_t count)
+{
+	if (dem->pre_agc) return scale_and_demod_s16(dem, dst, src, count, dem->loops->oqpsk_s16);
+	if (dem->qdecim.count) return decimate_and_demod_s16(dem, dst, src, count, dem->loops->oqpsk_s16);
+	return dem->loops->oqpsk_s16(dem, dst, src, count);
 }
 
 int
-demod_qpsk(float complex *sample)
+demod_set_rrc_order(Demod *dem, int rrc_order)
+{
+	const float osf = dem->samplerate / dem->symrate;
+	Filter rrc = {0};
+	QFilter qrrc = {0};
+
+	if (dem->fixed) {
+		if (qfilter_init_rrc(&qrrc, rrc_order, osf, RRC_ALPHA, dem->qrrc.interp_factor)) {
+			qfilter_deinit(&qrrc);
+			return 1;
+		}
+		qfilter_deinit(&dem->qrrc);
+		dem->qrrc = qrrc;
+	} else {
+		if (filter_init_rrc(&rrc, rrc_order, osf, RRC_ALPHA, dem->rrc.interp_factor)) {
+			filter_deinit(&rrc);
+			return 1;
+		}
+		filter_deinit(&dem->rrc);
+		dem->rrc = rrc;
+	}
+
+	return 0;
+}
+
+float
+demod_get_gain(const Demod *dem)
+{
+	const float gain = dem->fixed ? qagc_get_gain(&dem->qagc) : agc_get_gain(&dem->agc);
+	return dem->pre_agc ? gain * preagc_get_gain(&dem->preagc) : gain;
+}
+
+void
+demod_get_state(const Demod *dem, DemodState *state)
+{
+	state->carrier_freq = pll_get_freq(&dem->pll);
+	state->symbol_freq = mm_omega(&dem->timing);
+	state->gain = dem->fixed ? qagc_get_gain(&dem->qagc) : agc_get_gain(&dem->agc);
+	state->pre_gain = preagc_get_gain(&dem->preagc);
+}
+
+void
+demod_seed(Demod *dem, const DemodState *state)
+{
+	pll_set_freq(&dem->pll, state->carrier_freq);
+	dem->pll.sweep = 0;
+	timing_set_freq(&dem->timing, state->symbol_freq);
+	if (dem->fixed) {
+		qagc_set_gain(&dem->qagc, state->gain);
+	} else {
+		agc_set_gain(&dem->agc, state->gain);
+	}
+	if (dem->pre_agc) preagc_set_gain(&dem->preagc, state->pre_gain);
+	dem->seeded = 1;
+}
+
+/* Static functions {{{ */
+/**
+ * While the PLL is unlocked, feed samples to the coarse acquisition stage and
+ * seed the PLL with the resulting frequency estimates
+ */
+static void
+acquire(Demod *dem, float complex sample)
+{
+	float freq;
+
+	/* Trust the seeded frequency over whatever the acquisition picks up from
+	 * the noise before the signal shows up. Once locked, back to normal */
+	if (dem->seeded) {
+		if (!pll_did_lock_once(&dem->pll)) return;
+		dem->seeded = 0;
+		dem->pll.sweep = !dem->acq.buf;
+	}
+
+	if (!dem->acq.buf) return;
+
+	if (pll_get_locked(&dem->pll)) {
+		/* Start acquiring again as soon as lock is lost */
+		acq_restart(&dem->acq);
+	} else if (acq_feed(&dem->acq, sample, &freq)) {
+		pll_set_freq(&dem->pll, freq);
+	}
+}
+
+/**
+ * Run the decimation chain on a block of samples, then feed the decimated
+ * samples to the demodulation loop
+ */
+static size_t
+decimate_and_demod(Demod *dem, float complex *dst, const float complex *src, size_t count,
+                   size_t (*loop)(Demod*, float complex*, const float complex*, size_t))
+{
+	size_t chunk, decimated, produced;
+
+	produced = 0;
+	while (count > 0) {
+		chunk = MIN(count, DECIM_BLOCKSIZE);
+		PROFILE(&dem->prof, PROF_DECIM, decimated = decim_process(&dem->decim, dem->decim_buf, src, chunk));
+		produced += loop(dem, dst + produced, dem->decim_buf, decimated);
+
+		src += chunk;
+		count -= chunk;
+	}
+
+	return produced;
+}
+
+/**
+ * Fixed-point version of decimate_and_demod()
+ */
+static size_t
+decimate_and_demod_s16(Demod *dem, float complex *dst, const int16_t *src, size_t count,
+                       size_t (*loop)(Demod*, float complex*, const int16_t*, size_t))
+{
+	size_t chunk, decimated, produced;
+
+	produced = 0;
+	while (count > 0) {
+		chunk = MIN(count, DECIM_BLOCKSIZE);
+		PROFILE(&dem->prof, PROF_DECIM, decimated = qdecim_process(&dem->qdecim, dem->qdecim_buf, src, chunk));
+		produced += loop(dem, dst + produced, dem->qdecim_buf, decimated);
+
+		src += 2*chunk;
+		count -= chunk;
+	}
+
+	return produced;
+}
+
+/**
+ * Run a block of samples through the pre-filter AGC, then through the
+ * decimation chain and the demodulation loop
+ */
+static size_t
+scale_and_demod(Demod *dem, float complex *dst, const float complex *src, size_t count,
+                size_t (*loop)(Demod*, float complex*, const float complex*, size_t))
+{
+	size_t chunk, produced;
+
+	produced = 0;
+	while (count > 0) {
+		chunk = MIN(count, DECIM_BLOCKSIZE);
+		PROFILE(&dem->prof, PROF_AGC, preagc_apply(&dem->preagc, dem->preagc_buf, src, chunk));
+		if (dem->decim.count) {
+			produced += decimate_and_demod(dem, dst + produced, dem->preagc_buf, chunk, loop);
+		} else {
+			produced += loop(dem, dst + produced, dem->preagc_buf, chunk);
+		}
+
+		src += chunk;
+		count -= chunk;
+	}
+
+	return produced;
+}
+
+/**
+ * Fixed-point version of scale_and_demod()
+ */
+static size_t
+scale_and_demod_s16(Demod *dem, float complex *dst, const int16_t *src, size_t count,
+                    size_t (*loop)(Demod*, float complex*, const int16_t*, size_t))
+{
+	size_t chunk, produced;
+
+	produced = 0;
+	while (count > 0) {
+		chunk = MIN(count, DECIM_BLOCKSIZE);
+		PROFILE(&dem->prof, PROF_AGC, preagc_apply_s16(&dem->preagc, dem->qpreagc_buf, src, chunk));
+		if (dem->qdecim.count) {
+			produced += decimate_and_demod_s16(dem, dst + produced, dem->qpreagc_buf, chunk, loop);
+		} else {
+			produced += loop(dem, dst + produced, dem->qpreagc_buf, chunk);
+		}
+
+		src += 2*chunk;
+		count -= chunk;
+	}
+
+	return produced;
+}
+
+/**
+ * Convert the output of the fixed-point AGC to the same scale as the floating
+ * point one
+ */
+static float complex
+to_float(cint32 sample)
+{
+	const float scale = 1.0f / (1 << QAGC_FRAC_BITS);
+	return sample.re * scale + I * (sample.im * scale);
+}
+
+/* Demodulation loops, specialized for the most common interpolation factors
+ * plus a generic fallback for the others */
+#define LOOP_NAME(x) x##_1
+#define LOOP_INTERP(x) 1
+#include "demod_loop.h"
+#define LOOP_NAME(x) x##_2
+#define LOOP_INTERP(x) 2
+#include "demod_loop.h"
+#define LOOP_NAME(x) x##_4
+#define LOOP_INTERP(x) 4
+#include "demod_loop.h"
+#define LOOP_NAME(x) x##_5
+#define LOOP_INTERP(x) 5
+#include "demod_loop.h"
+#define LOOP_NAME(x) x##_generic
+#define LOOP_INTERP(x) (x)
+#include "demod_loop.h"
+
+static const struct demod_loops _loops[] = {
+	{ 1, qpsk_loop_1, oqpsk_loop_1, qpsk_loop_s16_1, oqpsk_loop_s16_1 },
+	{ 2, qpsk_loop_2, oqpsk_loop_2, qpsk_loop_s16_2, oqpsk_loop_s16_2 },
+	{ 4, qpsk_loop_4, oqpsk_loop_4, qpsk_loop_s16_4, oqpsk_loop_s16_4 },
+	{ 5, qpsk_loop_5, oqpsk_loop_5, qpsk_loop_s16_5, oqpsk_loop_s16_5 },
+	{ 0, qpsk_loop_generic, oqpsk_loop_generic, qpsk_loop_s16_generic, oqpsk_loop_s16_generic },
+};
+static const struct demod_loops _gardner_loops[] = {
+	{ 1, qpsk_loop_gardner_1, oqpsk_loop_gardner_1, NULL, NULL },
+	{ 2, qpsk_loop_gardner_2, oqpsk_loop_gardner_2, NULL, NULL },
+	{ 4, qpsk_loop_gardner_4, oqpsk_loop_gardner_4, NULL, NULL },
+	{ 5, qpsk_loop_gardner_5, oqpsk_loop_gardner_5, NULL, NULL },
+	{ 0, qpsk_loop_gardner_generic, oqpsk_loop_gardner_generic, NULL, NULL },
+};
+static const struct demod_loops _cubic_loops = { 1, qpsk_loop_cubic, oqpsk_loop_cubic, NULL, NULL };
+
+/**
+ * Pick the loops specialized for the given interpolation factor, or the
+ * generic ones if there are none
+ */
+static const struct demod_loops*
+select_loops(int interp_factor, int cubic, int gardner)
+{
+	const struct demod_loops *loops = gardner ? _gardner_loops : _loops;
+	size_t i;
+
+	if (cubic) return &_cubic_loops;
+
+	/* Both tables have the same specializations */
+	for (i=0; i<LEN(_loops)-1 && loops[i].interp_factor != interp_factor; i++)
+		;
+
+	return &loops[i];
+}
+
+/**
+ * Cubic interpolator version of qpsk_loop(): every sample goes through a
+ * single RRC filter, and symbols are interpolated from its output at the exact
+ * instant given by the symbol clock
+ */
+static size_t
+qpsk_loop_cubic(Demod *dem, float complex *restrict dst, const float complex *restrict src, size_t count)
 {
 	float complex out;
-	int i, ret;
+	size_t n, produced;
 
-	filter_fwd_sample(&_rrc_filter, *sample);
+	produced = 0;
+	for (n=0; n<count; n++) {
+		filter_fwd_sample(&dem->rrc, src[n]);
+		PROFILE(&dem->prof, PROF_FILTER, farrow_push(&dem->farrow, filter_get(&dem->rrc, 0)));
 
-	/* Check if this sample is in the correct timeslot */
-	ret = 0;
-	for (i=0; i<_rrc_filter.interp_factor; i++) {
-		if (advance_timeslot()) {
-			out = filter_get(&_rrc_filter, i);  /* Get the filter output */
-			out = agc_apply(out);               /* Apply AGC */
-			out = pll_mix(out);                 /* Mix with local oscillator */
+		if (advance_timeslot(&dem->timing)) {
+			PROFILE(&dem->prof, PROF_FILTER, out = farrow_get(&dem->farrow, timing_frac(&dem->timing, 2)));
+			PROFILE(&dem->prof, PROF_AGC, out = agc_apply(&dem->agc, out));
+			acquire(dem, out);
+			PROFILE(&dem->prof, PROF_PLL_MIX, out = pll_mix(&dem->pll, out));
 
-			retime(out);                                    /* Update symbol clock */
-			pll_update_estimate(crealf(out), cimagf(out));  /* Update carrier frequency */
+			PROFILE(&dem->prof, PROF_RETIME, retime(&dem->timing, out));
+			PROFILE(&dem->prof, PROF_PLL_UPDATE,
+			        pll_update_estimate(&dem->pll, crealf(out), cimagf(out)));
 
-			*sample = out;                      /* Write out symbol */
-			ret = 1;
+			dst[produced++] = out;
 		}
 	}
 
-	return ret;
+	return produced;
 }
 
-int
-demod_oqpsk(float complex *restrict sample)
+/**
+ * Cubic interpolator version of oqpsk_loop()
+ */
+static size_t
+oqpsk_loop_cubic(Demod *dem, float complex *restrict dst, const float complex *restrict src, size_t count)
 {
 	float complex out;
-	static float inphase;
 	float quad;
-	int i, ret;
-
-	filter_fwd_sample(&_rrc_filter, *sample);
-
-	/* Check if this sample is in the correct timeslot */
-	ret = 0;
-	for (i=0; i<_rrc_filter.interp_factor; i++) {
-		switch (advance_timeslot_dual()) {
-			case 0:
-				break;
-			case 1:
-				/* Intersample */
-				out = filter_get(&_rrc_filter, i);
-				out = agc_apply(out);
-				inphase = pll_mix_i(out);           /* We only care about the I value */
-				break;
-			case 2:
-				/* Actual sample */
-				out = filter_get(&_rrc_filter, i);  /* Get the filter output */
-				out = agc_apply(out);               /* Apply AGC */
-				quad = pll_mix_q(out);              /* We only care about the Q value */
-
-				*sample = inphase + I*quad;
-
-				retime(*sample);                      /* Update symbol clock */
-				pll_update_estimate(inphase, quad);  /* Update carrier frequency */
-				ret = 1;
-				break;
-			default:
-				break;
+	size_t n, produced;
+	int slot;
+
+	produced = 0;
+	for (n=0; n<count; n++) {
+		filter_fwd_sample(&dem->rrc, src[n]);
+		PROFILE(&dem->prof, PROF_FILTER, farrow_push(&dem->farrow, filter_get(&dem->rrc, 0)));
+
+		/* At low oversampling, both the intersample and the actual sample
+		 * can fall between two input samples */
+		for (slot = advance_timeslot_dual(&dem->timing); slot; slot = timeslot_due_dual(&dem->timing)) {
+			PROFILE(&dem->prof, PROF_FILTER, out = farrow_get(&dem->farrow, timing_frac(&dem->timing, slot)));
+			PROFILE(&dem->prof, PROF_AGC, out = agc_apply(&dem->agc, out));
+			acquire(dem, out);
+
+			if (slot == 1) {
+				/* Intersample: we only care about the I value */
+				PROFILE(&dem->prof, PROF_PLL_MIX, dem->inphase = pll_mix_i(&dem->pll, out));
+			} else {
+				/* Actual sample: we only care about the Q value */
+				PROFILE(&dem->prof, PROF_PLL_MIX, quad = pll_mix_q(&dem->pll, out));
+
+				out = dem->inphase + I*quad;
+
+				PROFILE(&dem->prof, PROF_RETIME, retime(&dem->timing, out));
+				PROFILE(&dem->prof, PROF_PLL_UPDATE,
+				        pll_update_estimate(&dem->pll, dem->inphase, quad));
 
+				dst[produced++] = out;
+			}
 		}
 	}
 
-	return ret;
+	return produced;
 }
+/* }}} */
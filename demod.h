@@ -1,8 +1,14 @@
 #pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "dsp/acq.h"
 #include "dsp/agc.h"
+#include "dsp/decim.h"
+#include "dsp/farrow.h"
 #include "dsp/filter.h"
 #include "dsp/pll.h"
 #include "dsp/timing.h"
+#include "profile.h"
 
 /* Satellite specific settings */
 #define RRC_ALPHA 0.6
@@ -13,9 +19,50 @@
 #define INTERP_FACTOR 5
 #define SYM_BW 0.00005
 #define PLL_BW 1
+#define DECIM_MIN_SPS 2.0
+#define ACQ_LEN 4096
+
+typedef struct {
+	Decimator decim;
+	float complex *decim_buf;
+	Filter rrc;
+	Farrow farrow;      /* Cubic timing interpolator, if enabled */
+	Acq acq;
+	Agc agc;
+	PreAgc preagc;      /* Input rate AGC, if enabled */
+	int pre_agc;
+	float complex *preagc_buf;
+	int16_t *qpreagc_buf;
+	int fixed;          /* 1 if using the fixed-point path (q* objects below) */
+	QDecimator qdecim;
+	int16_t *qdecim_buf;
+	QFilter qrrc;
+	QAgc qagc;
+	Pll pll;
+	Timing timing;
+	const struct demod_loops *loops;    /* Loops specialized for interp_factor */
+	int oqpsk;
+	int seeded;         /* 1 between demod_seed() and the first PLL lock */
+	float samplerate;   /* Sample rate after decimation */
+	float symrate;
+	float inphase;      /* Last I sample, OQPSK only */
+#ifdef ENABLE_PROFILING
+	Profile prof;
+#endif
+} Demod;
+
+/* Snapshot of the loop estimates, used to start a demodulator off where a
+ * previous one was */
+typedef struct {
+	float carrier_freq;     /* PLL frequency */
+	float symbol_freq;      /* Symbol timing frequency */
+	float gain;             /* AGC gain */
+	float pre_gain;         /* Pre-filter AGC gain */
+} DemodState;
 
 /**
- * Initialize demodulator
+ * Create a new demodulator context. Each context is fully independent, so
+ * multiple demodulators can run concurrently on different threads
  *
  * @param pll_bw carrier estimator PLL bandwidth
  * @param sym_bw symbol timing estimator bandwidth
@@ -25,26 +72,116 @@
  * @param rrc_order root-raised cosine order
  * @param oqpsk 1 if oqpsk, 0 if qpsk
  * @param freq_max max carrier frequency deviation, see pll.h for more info
+ * @param decim number of half-band decimation stages to apply before the RRC
+ *        filter, or -1 to decimate down to about DECIM_MIN_SPS samples per
+ *        symbol
+ * @param acq 1 to enable FFT-based coarse carrier acquisition whenever the PLL
+ *        is unlocked, 0 to rely on the PLL frequency sweep alone
+ * @param fixed 1 to use the 16-bit fixed-point signal path, which only accepts
+ *        samples through the demod_*_block_s16() functions, 0 to use the
+ *        floating point one
+ * @param cubic 1 to filter every sample with a single RRC filter and pick the
+ *        symbols with a cubic interpolator, 0 to use a polyphase filter bank
+ *        with interp_factor branches. interp_factor must be 1 in cubic mode,
+ *        which is not supported on the fixed-point path
+ * @param gardner 1 to recover the symbol clock with the Gardner detector, 0 to
+ *        use the Mueller & Muller one. Only supported on the floating point
+ *        path with the polyphase filter bank
+ * @param pre_agc 1 to scale the input samples to a fixed power before they
+ *        reach the decimator and the RRC filter, 0 to feed them in as they are
+ * @return demodulator context on success, NULL on failure
+ */
+Demod* demod_init(float pll_bw, float sym_bw, int samplerate, int symrate, int interp_factor, int rrc_order, int oqpsk, float freq_max, int decim, int acq, int fixed, int cubic, int gardner, int pre_agc);
+
+/**
+ * Deinitialize a demodulator, freeing the context
+ *
+ * @param dem demodulator to free
+ */
+void demod_deinit(Demod *dem);
+
+/**
+ * Feed a block of QPSK samples into the demodulator
+ *
+ * @param dem demodulator to use
+ * @param dst buffer to write the demodulated symbols to. Must be able to hold
+ *        at least count symbols (as long as samplerate > symrate, each input
+ *        sample produces at most one symbol)
+ * @param src input samples
+ * @param count number of samples in src
+ * @return number of symbols written to dst
+ */
+size_t demod_qpsk_block(Demod *dem, float complex *dst, const float complex *src, size_t count);
+
+/**
+ * Feed a block of OQPSK samples into the demodulator
+ *
+ * @param dem demodulator to use
+ * @param dst buffer to write the demodulated symbols to, see demod_qpsk_block()
+ * @param src input samples
+ * @param count number of samples in src
+ * @return number of symbols written to dst
  */
-void demod_init(float pll_bw, float sym_bw, int samplerate, int symrate, int interp_factor, int rrc_order, int oqpsk, float freq_max);
+size_t demod_oqpsk_block(Demod *dem, float complex *dst, const float complex *src, size_t count);
 
 /**
- * Deinitialize demodulator
+ * Feed a block of 16-bit QPSK samples into a fixed-point demodulator
+ *
+ * @param dem demodulator to use, initialized with fixed=1
+ * @param dst buffer to write the demodulated symbols to, see demod_qpsk_block()
+ * @param src input samples, interleaved I/Q
+ * @param count number of I/Q pairs in src
+ * @return number of symbols written to dst
+ */
+size_t demod_qpsk_block_s16(Demod *dem, float complex *dst, const int16_t *src, size_t count);
+
+/**
+ * Feed a block of 16-bit OQPSK samples into a fixed-point demodulator
+ *
+ * @param dem demodulator to use, initialized with fixed=1
+ * @param dst buffer to write the demodulated symbols to, see demod_qpsk_block()
+ * @param src input samples, interleaved I/Q
+ * @param count number of I/Q pairs in src
+ * @return number of symbols written to dst
+ */
+size_t demod_oqpsk_block_s16(Demod *dem, float complex *dst, const int16_t *src, size_t count);
+
+/**
+ * Replace the RRC filter of a demodulator with one of a different order,
+ * e.g. to make it cheaper when it can't keep up with a live input. The new
+ * filter starts off empty, so the symbols spanning the switch are lost
+ *
+ * @param dem demodulator to update
+ * @param rrc_order new root-raised cosine order
+ * @return 0 on success, 1 on failure, in which case the old filter is kept
+ */
+int demod_set_rrc_order(Demod *dem, int rrc_order);
+
+/**
+ * Get the current AGC gain of a demodulator, regardless of the signal path.
+ * Includes the gain of the pre-filter AGC, if enabled
+ *
+ * @param dem demodulator to query
+ * @return gain
  */
-void demod_deinit();
+float demod_get_gain(const Demod *dem);
 
 /**
- * Feed a QPSK sample into the demodulator
+ * Take a snapshot of the carrier, symbol timing and gain estimates
  *
- * @param sample pointer to sample to use
- * @return 1 if sample was updated to a demodulateed symbol, 0 otherwise
+ * @param dem demodulator to query
+ * @param state filled with the current estimates
  */
-int demod_qpsk(float complex *sample);
+void demod_get_state(const Demod *dem, DemodState *state);
 
 /**
- * Feed a QPSK sample into the demodulator
+ * Start a demodulator off with previously measured estimates. The demodulator
+ * must have been created with the same parameters as the one the estimates
+ * come from. Until the PLL locks, the coarse carrier acquisition and frequency
+ * sweep are suspended, so that they don't drag the PLL away from the seeded
+ * frequency while there's no signal
  *
- * @param sample pointer to sample to use
- * @return 1 if sample was updated to a demodulateed symbol, 0 otherwise
+ * @param dem demodulator to seed, before any sample is fed to it
+ * @param state estimates, as returned by demod_get_state()
  */
-int demod_oqpsk(float complex *sample);
+void demod_seed(Demod *dem, const DemodState *state);
@@ -0,0 +1,285 @@
+/**
+ * Demodulation loop template, included by demod.c once per specialization.
+ * Before including it, define:
+ *   LOOP_NAME(x)    x followed by a suffix identifying the specialization
+ *   LOOP_INTERP(x)  the interpolation factor: a constant, so that the compiler
+ *                   can turn the divisions by it into multiplications, or x
+ *                   for the generic version
+ *
+ * The symbol clock takes interp_factor steps per input sample, step i of
+ * sample n being served by polyphase branch i. Rather than stepping it one
+ * branch at a time, the loops skip straight to the next timeslot, and only
+ * feed the filter the samples in between
+ */
+
+static size_t
+LOOP_NAME(qpsk_loop)(Demod *dem, float complex *restrict dst, const float complex *restrict src, size_t count)
+{
+	const size_t interp_factor = LOOP_INTERP(dem->rrc.interp_factor);
+	const size_t steps = count * interp_factor;
+	float complex out;
+	size_t n, step, skip, produced;
+
+	produced = 0;
+	for (n=0, step=0; (skip = skip_to_timeslot(&dem->timing, steps - step)); ) {
+		/* The timeslot falls on step - 1: feed the filter up to that sample */
+		step += skip;
+		for (; n <= (step - 1) / interp_factor; n++) {
+			filter_fwd_sample(&dem->rrc, src[n]);
+		}
+
+		PROFILE(&dem->prof, PROF_FILTER,
+		        out = filter_get(&dem->rrc, (step - 1) % interp_factor));  /* Get the filter output */
+		PROFILE(&dem->prof, PROF_AGC, out = agc_apply(&dem->agc, out));     /* Apply AGC */
+		acquire(dem, out);                                                  /* Coarse carrier acquisition */
+		PROFILE(&dem->prof, PROF_PLL_MIX, out = pll_mix(&dem->pll, out));   /* Mix with local oscillator */
+
+		PROFILE(&dem->prof, PROF_RETIME, retime(&dem->timing, out));        /* Update symbol clock */
+		PROFILE(&dem->prof, PROF_PLL_UPDATE,
+		        pll_update_estimate(&dem->pll, crealf(out), cimagf(out)));  /* Update carrier frequency */
+
+		dst[produced++] = out;                  /* Write out symbol */
+	}
+
+	/* No more timeslots in this block */
+	for (; n<count; n++) {
+		filter_fwd_sample(&dem->rrc, src[n]);
+	}
+
+	return produced;
+}
+
+static size_t
+LOOP_NAME(oqpsk_loop)(Demod *dem, float complex *restrict dst, const float complex *restrict src, size_t count)
+{
+	const size_t interp_factor = LOOP_INTERP(dem->rrc.interp_factor);
+	const size_t steps = count * interp_factor;
+	float complex out;
+	float quad;
+	size_t n, step, skip, produced;
+	int slot;
+
+	produced = 0;
+	for (n=0, step=0; (skip = skip_to_timeslot_dual(&dem->timing, steps - step, &slot)); ) {
+		step += skip;
+		for (; n <= (step - 1) / interp_factor; n++) {
+			filter_fwd_sample(&dem->rrc, src[n]);
+		}
+
+		PROFILE(&dem->prof, PROF_FILTER,
+		        out = filter_get(&dem->rrc, (step - 1) % interp_factor));  /* Get the filter output */
+		PROFILE(&dem->prof, PROF_AGC, out = agc_apply(&dem->agc, out));     /* Apply AGC */
+		acquire(dem, out);                                                  /* Coarse carrier acquisition */
+
+		if (slot == 1) {
+			/* Intersample */
+			PROFILE(&dem->prof, PROF_PLL_MIX,
+			        dem->inphase = pll_mix_i(&dem->pll, out));     /* We only care about the I value */
+		} else {
+			/* Actual sample */
+			PROFILE(&dem->prof, PROF_PLL_MIX, quad = pll_mix_q(&dem->pll, out)); /* We only care about the Q value */
+
+			out = dem->inphase + I*quad;
+
+			PROFILE(&dem->prof, PROF_RETIME, retime(&dem->timing, out));       /* Update symbol clock */
+			PROFILE(&dem->prof, PROF_PLL_UPDATE,
+			        pll_update_estimate(&dem->pll, dem->inphase, quad));       /* Update carrier frequency */
+
+			dst[produced++] = out;
+		}
+	}
+
+	for (; n<count; n++) {
+		filter_fwd_sample(&dem->rrc, src[n]);
+	}
+
+	return produced;
+}
+
+/**
+ * Gardner detector version of qpsk_loop(): the filter is also evaluated
+ * halfway between symbols, and the timing error is computed before the PLL
+ */
+static size_t
+LOOP_NAME(qpsk_loop_gardner)(Demod *dem, float complex *restrict dst, const float complex *restrict src, size_t count)
+{
+	const size_t interp_factor = LOOP_INTERP(dem->rrc.interp_factor);
+	const size_t steps = count * interp_factor;
+	float complex out;
+	size_t n, step, skip, produced;
+	int slot;
+
+	produced = 0;
+	for (n=0, step=0; (skip = skip_to_timeslot_dual(&dem->timing, steps - step, &slot)); ) {
+		step += skip;
+		for (; n <= (step - 1) / interp_factor; n++) {
+			filter_fwd_sample(&dem->rrc, src[n]);
+		}
+
+		PROFILE(&dem->prof, PROF_FILTER, out = filter_get(&dem->rrc, (step - 1) % interp_factor));
+
+		if (slot == 1) {
+			/* Intersample: only used for timing, don't let it affect the AGC */
+			PROFILE(&dem->prof, PROF_AGC, out = agc_scale(&dem->agc, out));
+			timing_midpoint(&dem->timing, out);
+		} else {
+			PROFILE(&dem->prof, PROF_AGC, out = agc_apply(&dem->agc, out));
+			acquire(dem, out);
+			PROFILE(&dem->prof, PROF_RETIME, retime_gardner(&dem->timing, out));
+			PROFILE(&dem->prof, PROF_PLL_MIX, out = pll_mix(&dem->pll, out));
+			PROFILE(&dem->prof, PROF_PLL_UPDATE,
+			        pll_update_estimate(&dem->pll, crealf(out), cimagf(out)));
+
+			dst[produced++] = out;
+		}
+	}
+
+	for (; n<count; n++) {
+		filter_fwd_sample(&dem->rrc, src[n]);
+	}
+
+	return produced;
+}
+
+/**
+ * Gardner detector version of oqpsk_loop(). Both halves of a symbol go through
+ * the same steps: the detector needs the full carrier-corrected intersample
+ */
+static size_t
+LOOP_NAME(oqpsk_loop_gardner)(Demod *dem, float complex *restrict dst, const float complex *restrict src, size_t count)
+{
+	const size_t interp_factor = LOOP_INTERP(dem->rrc.interp_factor);
+	const size_t steps = count * interp_factor;
+	float complex out;
+	size_t n, step, skip, produced;
+	int slot;
+
+	produced = 0;
+	for (n=0, step=0; (skip = skip_to_timeslot_dual(&dem->timing, steps - step, &slot)); ) {
+		step += skip;
+		for (; n <= (step - 1) / interp_factor; n++) {
+			filter_fwd_sample(&dem->rrc, src[n]);
+		}
+
+		PROFILE(&dem->prof, PROF_FILTER, out = filter_get(&dem->rrc, (step - 1) % interp_factor));
+		PROFILE(&dem->prof, PROF_AGC, out = agc_apply(&dem->agc, out));
+		acquire(dem, out);
+		PROFILE(&dem->prof, PROF_PLL_MIX, out = pll_mix(&dem->pll, out));
+
+		if (slot == 1) {
+			/* Intersample */
+			timing_midpoint(&dem->timing, out);
+			dem->inphase = crealf(out);
+		} else {
+			/* Actual sample */
+			PROFILE(&dem->prof, PROF_RETIME, retime_gardner_oqpsk(&dem->timing, out));
+
+			out = dem->inphase + I*cimagf(out);
+			PROFILE(&dem->prof, PROF_PLL_UPDATE,
+			        pll_update_estimate(&dem->pll, crealf(out), cimagf(out)));
+
+			dst[produced++] = out;
+		}
+	}
+
+	for (; n<count; n++) {
+		filter_fwd_sample(&dem->rrc, src[n]);
+	}
+
+	return produced;
+}
+
+/**
+ * Fixed-point version of qpsk_loop(): everything running at the sample rate is
+ * done in 16-bit arithmetic, while the symbol-rate loops (timing recovery and
+ * PLL error estimation) still operate on floats
+ */
+static size_t
+LOOP_NAME(qpsk_loop_s16)(Demod *dem, float complex *restrict dst, const int16_t *restrict src, size_t count)
+{
+	const size_t interp_factor = LOOP_INTERP(dem->qrrc.interp_factor);
+	const size_t steps = count * interp_factor;
+	cint32 sample;
+	float complex out;
+	size_t n, step, skip, produced;
+
+	produced = 0;
+	for (n=0, step=0; (skip = skip_to_timeslot(&dem->timing, steps - step)); ) {
+		step += skip;
+		for (; n <= (step - 1) / interp_factor; n++) {
+			qfilter_fwd_sample(&dem->qrrc, src[2*n], src[2*n+1]);
+		}
+
+		PROFILE(&dem->prof, PROF_FILTER, sample = qfilter_get(&dem->qrrc, (step - 1) % interp_factor));
+		PROFILE(&dem->prof, PROF_AGC, sample = qagc_apply(&dem->qagc, sample));
+		acquire(dem, to_float(sample));
+		PROFILE(&dem->prof, PROF_PLL_MIX, sample = pll_mix_fixed(&dem->pll, sample));
+		out = to_float(sample);
+
+		PROFILE(&dem->prof, PROF_RETIME, retime(&dem->timing, out));
+		PROFILE(&dem->prof, PROF_PLL_UPDATE,
+		        pll_update_estimate(&dem->pll, crealf(out), cimagf(out)));
+
+		dst[produced++] = out;
+	}
+
+	for (; n<count; n++) {
+		qfilter_fwd_sample(&dem->qrrc, src[2*n], src[2*n+1]);
+	}
+
+	return produced;
+}
+
+/**
+ * Fixed-point version of oqpsk_loop()
+ */
+static size_t
+LOOP_NAME(oqpsk_loop_s16)(Demod *dem, float complex *restrict dst, const int16_t *restrict src, size_t count)
+{
+	const size_t interp_factor = LOOP_INTERP(dem->qrrc.interp_factor);
+	const size_t steps = count * interp_factor;
+	const float scale = 1.0f / (1 << QAGC_FRAC_BITS);
+	cint32 sample;
+	float complex out;
+	float quad;
+	size_t n, step, skip, produced;
+	int slot;
+
+	produced = 0;
+	for (n=0, step=0; (skip = skip_to_timeslot_dual(&dem->timing, steps - step, &slot)); ) {
+		step += skip;
+		for (; n <= (step - 1) / interp_factor; n++) {
+			qfilter_fwd_sample(&dem->qrrc, src[2*n], src[2*n+1]);
+		}
+
+		PROFILE(&dem->prof, PROF_FILTER, sample = qfilter_get(&dem->qrrc, (step - 1) % interp_factor));
+		PROFILE(&dem->prof, PROF_AGC, sample = qagc_apply(&dem->qagc, sample));
+		acquire(dem, to_float(sample));
+		PROFILE(&dem->prof, PROF_PLL_MIX, sample = pll_mix_fixed(&dem->pll, sample));
+
+		if (slot == 1) {
+			/* Intersample */
+			dem->inphase = sample.re * scale;
+		} else {
+			/* Actual sample */
+			quad = sample.im * scale;
+
+			out = dem->inphase + I*quad;
+
+			PROFILE(&dem->prof, PROF_RETIME, retime(&dem->timing, out));
+			PROFILE(&dem->prof, PROF_PLL_UPDATE,
+			        pll_update_estimate(&dem->pll, dem->inphase, quad));
+
+			dst[produced++] = out;
+		}
+	}
+
+	for (; n<count; n++) {
+		qfilter_fwd_sample(&dem->qrrc, src[2*n], src[2*n+1]);
+	}
+
+	return produced;
+}
+
+#undef LOOP_NAME
+#undef LOOP_INTERP
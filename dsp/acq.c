@@ -0,0 +1,81 @@
+#include <math.h>
+#include <stdlib.h>
+#include "acq.h"
+#include "fft.h"
+
+/* After an estimate, give the PLL this many windows to lock on before trying
+ * again */
+#define HOLDOFF_WINDOWS 2
+
+int
+acq_init(Acq *acq, unsigned len)
+{
+	if (!len || (len & (len - 1))) return 1;
+	if (!(acq->buf = malloc(sizeof(*acq->buf) * len))) return 1;
+
+	acq->len = len;
+	acq_restart(acq);
+
+	return 0;
+}
+
+void
+acq_deinit(Acq *acq)
+{
+	if (acq->buf) { free(acq->buf); acq->buf=NULL; }
+}
+
+void
+acq_restart(Acq *acq)
+{
+	acq->idx = 0;
+	acq->holdoff = 0;
+}
+
+int
+acq_feed(Acq *acq, float complex sample, float *freq)
+{
+	float complex sq;
+	float mag, peak, prev, next, delta;
+	unsigned i, peak_idx;
+
+	if (acq->holdoff) {
+		acq->holdoff--;
+		return 0;
+	}
+
+	/* Raise to the 4th power, normalizing the magnitude so that strong
+	 * outliers don't dominate the spectrum */
+	mag = crealf(sample)*crealf(sample) + cimagf(sample)*cimagf(sample);
+	sq = mag > 0 ? sample*sample/mag : 0;
+	acq->buf[acq->idx++] = sq*sq;
+
+	if (acq->idx < acq->len) return 0;
+
+	/* Find the spectral line */
+	fft(acq->buf, acq->len);
+	peak = 0;
+	peak_idx = 0;
+	for (i=0; i<acq->len; i++) {
+		mag = crealf(acq->buf[i])*crealf(acq->buf[i]) + cimagf(acq->buf[i])*cimagf(acq->buf[i]);
+		if (mag > peak) {
+			peak = mag;
+			peak_idx = i;
+		}
+	}
+
+	/* Refine with parabolic interpolation around the peak */
+	prev = cabsf(acq->buf[(peak_idx + acq->len - 1) % acq->len]);
+	next = cabsf(acq->buf[(peak_idx + 1) % acq->len]);
+	peak = sqrtf(peak);
+	delta = (prev - 2*peak + next) != 0 ? 0.5 * (prev - next) / (prev - 2*peak + next) : 0;
+
+	/* Convert bin to frequency in [-pi, pi), then undo the 4th power */
+	*freq = 2*M_PI * (peak_idx + delta) / acq->len;
+	if (*freq >= M_PI) *freq -= 2*M_PI;
+	*freq /= 4;
+
+	acq->idx = 0;
+	acq->holdoff = HOLDOFF_WINDOWS * acq->len;
+	return 1;
+}
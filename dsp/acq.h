@@ -0,0 +1,48 @@
+#ifndef acq_h
+#define acq_h
+#include <complex.h>
+
+typedef struct {
+	float complex *buf;
+	unsigned len, idx;
+	unsigned holdoff;           /* Samples to skip before the next estimate */
+} Acq;
+
+/**
+ * Initialize a coarse carrier acquisition stage. The carrier offset is
+ * estimated from the FFT of the signal raised to the 4th power, which strips
+ * the QPSK modulation and leaves a spectral line at 4x the offset
+ *
+ * @param acq acquisition object to initialize
+ * @param len number of samples to use for each estimate, must be a power of 2
+ * @return 0 on success, 1 on failure
+ */
+int acq_init(Acq *acq, unsigned len);
+
+/**
+ * Deinitialize an acquisition object
+ *
+ * @param acq acquisition object to deinitialize
+ */
+void acq_deinit(Acq *acq);
+
+/**
+ * Feed a sample to the acquisition stage
+ *
+ * @param acq acquisition object to use
+ * @param sample sample to feed, before mixing with the local oscillator
+ * @param freq pointer filled with the frequency estimate, in radians per
+ *        sample, when available
+ * @return 1 if a new estimate was written to freq, 0 otherwise
+ */
+int acq_feed(Acq *acq, float complex sample, float *freq);
+
+/**
+ * Discard any partial estimate and the hold-off period, so that the next
+ * estimate starts from the next sample fed
+ *
+ * @param acq acquisition object to restart
+ */
+void acq_restart(Acq *acq);
+
+#endif
@@ -1,31 +1,247 @@
 #include <math.h>
+#include <stdlib.h>
 #include "agc.h"
 #include "utils.h"
 
 #define FLOAT_TARGET_MAG 190
 #define BIAS_POLE 0.001f
-#define GAIN_POLE 0.0001f
+#define MAG_POLE 0.25f          /* Per block of AGC_BLOCK samples */
+#define FLOAT_MAX_OUT 2048      /* Same range as the fixed-point output */
 
-static float _float_gain = 1;
-static float complex _float_bias = 0;
+/* Fixed-point equivalents of the above. The poles are powers of two, so that
+ * the updates are just shifts. The gain update is relative to the current gain
+ * rather than absolute, so that the loop behaves the same regardless of the
+ * input scale (8-bit input is scaled up by 256 on the fixed-point path, which
+ * would make the absolute update unstable) */
+#define QTARGET_MAG (FLOAT_TARGET_MAG << QAGC_FRAC_BITS)
+#define QGAIN_BITS 24
+#define QBIAS_SHIFT 10          /* ~0.001 */
+#define QGAIN_SHIFT 13
+
+/* RMS level of the pre-filter AGC output, 18dB below 16-bit full scale */
+#define PRE_TARGET_RMS 4096
+#define PRE_POWER_POLE 0.25f    /* Per block */
+#define PRE_QGAIN_BITS 8
+
+static void agc_update(Agc *agc);
+static float complex saturate(float complex sample);
+static float preagc_update(PreAgc *agc, float power);
+
+void
+agc_init(Agc *agc)
+{
+	agc->gain = 1;
+	agc->bias = 0;
+	agc->mag = 0;
+	agc->block_sum = 0;
+	agc->block_mag = 0;
+	agc->block_len = 0;
+}
 
 float complex
-agc_apply(float complex sample)
+agc_apply(Agc *agc, float complex sample)
 {
+	float abs_re, abs_im;
+
 	/* Remove DC bias */
-	_float_bias = _float_bias*(1-BIAS_POLE) + BIAS_POLE*sample;
-	sample -= _float_bias;
+	sample -= agc->bias;
+
+	/* Only accumulate the block statistics here: the gain and bias only change
+	 * at the end of the block, so the next sample doesn't have to wait for
+	 * them to be updated. The magnitude uses the same approximation as the
+	 * fixed-point AGC rather than a square root */
+	abs_re = fabsf(crealf(sample));
+	abs_im = fabsf(cimagf(sample));
+	agc->block_sum += sample;
+	agc->block_mag += MAX(abs_re, abs_im) * 15/16 + MIN(abs_re, abs_im) * 15/32;
+	if (++agc->block_len == AGC_BLOCK) agc_update(agc);
 
-	/* Apply AGC */
-	sample *= _float_gain;
-	_float_gain += GAIN_POLE*(FLOAT_TARGET_MAG - cabsf(sample));
-	_float_gain = MAX(0, _float_gain);
+	return saturate(sample * agc->gain);
+}
+
+float complex
+agc_scale(const Agc *agc, float complex sample)
+{
+	return saturate((sample - agc->bias) * agc->gain);
+}
+
+float
+agc_get_gain(const Agc *agc)
+{
+	return agc->gain;
+}
+
+void
+agc_set_gain(Agc *agc, float gain)
+{
+	agc->gain = MAX(0, gain);
+	agc->mag = gain > 0 ? FLOAT_TARGET_MAG / gain : 0;
+}
+
+void
+preagc_init(PreAgc *agc)
+{
+	agc->gain = 1;
+	agc->power = 0;
+}
+
+void
+preagc_apply(PreAgc *agc, float complex *dst, const float complex *src, size_t count)
+{
+	float power, gain;
+	size_t i;
+
+	power = 0;
+	for (i=0; i<count; i++) {
+		power += crealf(src[i])*crealf(src[i]) + cimagf(src[i])*cimagf(src[i]);
+	}
+	gain = count ? preagc_update(agc, power / count) : agc->gain;
+
+	for (i=0; i<count; i++) {
+		dst[i] = src[i] * gain;
+	}
+}
+
+void
+preagc_apply_s16(PreAgc *agc, int16_t *dst, const int16_t *src, size_t count)
+{
+	int64_t power;
+	int32_t gain, sample;
+	float fgain;
+	size_t i;
+
+	power = 0;
+	for (i=0; i<2*count; i++) {
+		power += src[i] * src[i];
+	}
+	fgain = count ? preagc_update(agc, (float)power / count) : agc->gain;
+
+	/* Q(PRE_QGAIN_BITS), capped so that the product fits in 32 bits */
+	gain = MAX(1, MIN(UINT16_MAX, fgain * (1 << PRE_QGAIN_BITS)));
+	for (i=0; i<2*count; i++) {
+		sample = (src[i] * gain) >> PRE_QGAIN_BITS;
+		dst[i] = MAX(INT16_MIN, MIN(INT16_MAX, sample));
+	}
+}
+
+float
+preagc_get_gain(const PreAgc *agc)
+{
+	return agc->gain;
+}
+
+void
+preagc_set_gain(PreAgc *agc, float gain)
+{
+	agc->gain = MAX(0, gain);
+	agc->power = gain > 0 ? (PRE_TARGET_RMS / gain) * (PRE_TARGET_RMS / gain) : 0;
+}
+
+void
+qagc_init(QAgc *agc)
+{
+	agc->gain = 1 << QGAIN_BITS;
+	agc->bias_re = agc->bias_im = 0;
+}
+
+cint32
+qagc_apply(QAgc *agc, cint32 sample)
+{
+	int32_t abs_re, abs_im, mag;
+	int64_t re, im, gain;
+
+	/* Remove DC bias */
+	agc->bias_re += (sample.re * 256 - agc->bias_re) >> QBIAS_SHIFT;
+	agc->bias_im += (sample.im * 256 - agc->bias_im) >> QBIAS_SHIFT;
+	re = sample.re - (agc->bias_re >> 8);
+	im = sample.im - (agc->bias_im >> 8);
+
+	/* Apply AGC, Q(QAGC_FRAC_BITS) result */
+	re = (re * agc->gain) >> (QGAIN_BITS - QAGC_FRAC_BITS);
+	im = (im * agc->gain) >> (QGAIN_BITS - QAGC_FRAC_BITS);
+	sample.re = Q15_SATURATE(re);
+	sample.im = Q15_SATURATE(im);
+
+	/* Alpha max plus beta min approximation of the magnitude, within a couple
+	 * percent of the real value around the QPSK constellation points */
+	abs_re = abs(sample.re);
+	abs_im = abs(sample.im);
+	mag = MAX(abs_re, abs_im) * 15/16 + MIN(abs_re, abs_im) * 15/32;
+
+	/* Limit each step to +-50%, so that the gain can't collapse to zero when
+	 * the output is saturated */
+	gain = (agc->gain * (int64_t)(QTARGET_MAG - mag)) >> QGAIN_SHIFT;
+	gain = agc->gain + MAX(-agc->gain/2, MIN(agc->gain/2, gain));
+	agc->gain = MAX(1, MIN(INT32_MAX, gain));
 
 	return sample;
 }
 
 float
-agc_get_gain()
+qagc_get_gain(const QAgc *agc)
 {
-	return _float_gain;
+	return agc->gain / (float)(1 << QGAIN_BITS);
+}
+
+void
+qagc_set_gain(QAgc *agc, float gain)
+{
+	/* Q24 can't represent gains of 128 and above */
+	gain = MAX(0, MIN(127, gain));
+	agc->gain = MAX(1, (int32_t)(gain * (1 << QGAIN_BITS)));
+}
+
+/* Static functions {{{ */
+/**
+ * End of an AGC block: move the bias towards the mean of the block, and
+ * recompute the gain from the smoothed mean magnitude
+ */
+static void
+agc_update(Agc *agc)
+{
+	const float mag = agc->block_mag / AGC_BLOCK;
+
+	/* Same time constant as a per-sample IIR with pole BIAS_POLE */
+	agc->bias += BIAS_POLE * agc->block_sum;
+
+	/* Leave the gain alone on silence (e.g. samples lost over the network) */
+	if (mag > 0) {
+		agc->mag = agc->mag > 0 ? agc->mag + MAG_POLE*(mag - agc->mag) : mag;
+		agc->gain = FLOAT_TARGET_MAG / agc->mag;
+	}
+
+	agc->block_sum = 0;
+	agc->block_mag = 0;
+	agc->block_len = 0;
+}
+
+/**
+ * Clip a scaled sample to +-FLOAT_MAX_OUT. The gain only follows the input
+ * level from one block to the next, so a sudden rise in level (e.g. a long
+ * filter's output going from its impulse response tail to the actual signal)
+ * goes through a whole block scaled by a gain orders of magnitude too high,
+ * which would otherwise throw the timing and carrier loops off for good
+ */
+static float complex
+saturate(float complex sample)
+{
+	return MAX(-FLOAT_MAX_OUT, MIN(FLOAT_MAX_OUT, crealf(sample)))
+	     + I*MAX(-FLOAT_MAX_OUT, MIN(FLOAT_MAX_OUT, cimagf(sample)));
+}
+
+/**
+ * Update the pre-filter AGC with the mean power of a new block
+ *
+ * @return gain to apply to the block
+ */
+static float
+preagc_update(PreAgc *agc, float power)
+{
+	if (power > 0) {
+		agc->power = agc->power > 0 ? agc->power + PRE_POWER_POLE*(power - agc->power) : power;
+		agc->gain = PRE_TARGET_RMS / sqrtf(agc->power);
+	}
+
+	return agc->gain;
 }
+/* }}} */
@@ -1,20 +1,157 @@
 #ifndef agc_h
 #define agc_h
 #include <complex.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "q15.h"
+
+/* Fractional bits in the output of the fixed-point AGC */
+#define QAGC_FRAC_BITS 4
+
+/* Number of samples the AGC averages the magnitude over between gain updates */
+#define AGC_BLOCK 32
+
+typedef struct {
+	float gain;
+	float complex bias;
+	float mag;                      /* Smoothed mean magnitude, 0 before the first block */
+	float complex block_sum;        /* Sum of the samples in the current block */
+	float block_mag;                /* Sum of their magnitudes */
+	int block_len;
+} Agc;
+
+/**
+ * Initialize an automatic gain control loop
+ *
+ * @param agc AGC object to initialize
+ */
+void agc_init(Agc *agc);
 
 /**
- * Automatic gain control loop
+ * Automatic gain control loop. The gain is derived from the mean magnitude
+ * over blocks of AGC_BLOCK samples, and stays constant within a block
  *
+ * @param agc AGC object to use
  * @param sample sample to rescale
  * @return scaled sample
  */
-float complex agc_apply(float complex sample);
+float complex agc_apply(Agc *agc, float complex sample);
+
+/**
+ * Rescale a sample like agc_apply() would, without updating the AGC loop
+ *
+ * @param agc AGC object to use
+ * @param sample sample to rescale
+ * @return scaled sample
+ */
+float complex agc_scale(const Agc *agc, float complex sample);
 
 /**
  * Get the current gain of the AGC
  *
+ * @param agc AGC object to query
  * @return gain
  */
-float agc_get_gain();
+float agc_get_gain(const Agc *agc);
+
+/**
+ * Set the gain of the AGC, e.g. to a value measured during a previous run
+ *
+ * @param agc AGC object to modify
+ * @param gain new gain
+ */
+void agc_set_gain(Agc *agc, float gain);
+
+/* Pre-filter AGC, scaling whole blocks of input samples to a fixed power
+ * before they reach the decimator and the RRC filter */
+typedef struct {
+	float gain;
+	float power;                    /* Smoothed mean power, 0 before the first block */
+} PreAgc;
+
+/**
+ * Initialize a pre-filter AGC
+ *
+ * @param agc AGC object to initialize
+ */
+void preagc_init(PreAgc *agc);
+
+/**
+ * Measure the power of a block of samples, update the gain, and scale the
+ * block with it
+ *
+ * @param agc AGC object to use
+ * @param dst buffer to write the scaled samples to, can be the same as src
+ * @param src samples to scale
+ * @param count number of samples in src
+ */
+void preagc_apply(PreAgc *agc, float complex *dst, const float complex *src, size_t count);
+
+/**
+ * 16-bit version of preagc_apply(). The output saturates instead of wrapping
+ * around
+ *
+ * @param agc AGC object to use
+ * @param dst buffer to write the scaled samples to, can be the same as src
+ * @param src samples to scale, interleaved I/Q
+ * @param count number of I/Q pairs in src
+ */
+void preagc_apply_s16(PreAgc *agc, int16_t *dst, const int16_t *src, size_t count);
+
+/**
+ * Get the current gain of a pre-filter AGC
+ *
+ * @param agc AGC object to query
+ * @return gain
+ */
+float preagc_get_gain(const PreAgc *agc);
+
+/**
+ * Set the gain of a pre-filter AGC
+ *
+ * @param agc AGC object to modify
+ * @param gain new gain
+ */
+void preagc_set_gain(PreAgc *agc, float gain);
+
+/* Fixed-point version of agc_apply() */
+typedef struct {
+	int32_t gain;                   /* Q24 */
+	int32_t bias_re, bias_im;       /* Q8 */
+} QAgc;
+
+/**
+ * Initialize a fixed-point automatic gain control loop
+ *
+ * @param agc AGC object to initialize
+ */
+void qagc_init(QAgc *agc);
+
+/**
+ * Fixed-point automatic gain control loop. The output has the same magnitude
+ * as the one of agc_apply(), with QAGC_FRAC_BITS fractional bits, and is
+ * guaranteed to fit in 16 bits
+ *
+ * @param agc AGC object to use
+ * @param sample sample to rescale
+ * @return scaled sample
+ */
+cint32 qagc_apply(QAgc *agc, cint32 sample);
+
+/**
+ * Get the current gain of the fixed-point AGC
+ *
+ * @param agc AGC object to query
+ * @return gain
+ */
+float qagc_get_gain(const QAgc *agc);
+
+/**
+ * Set the gain of the fixed-point AGC
+ *
+ * @param agc AGC object to modify
+ * @param gain new gain, as returned by qagc_get_gain()
+ */
+void qagc_set_gain(QAgc *agc, float gain);
 
 #endif
@@ -0,0 +1,293 @@
+#include <math.h>
+#include <stdlib.h>
+#include "decim.h"
+#include "utils.h"
+
+#define MIN_SIDE_TAPS 3
+#define MAX_SIDE_TAPS 16
+
+static float* halfband_design(float passband, int *side);
+static int halfband_init(Halfband *hb, float passband);
+static void halfband_deinit(Halfband *hb);
+static size_t halfband_process(Halfband *hb, float complex *dst, const float complex *src, size_t count);
+static int qhalfband_init(QHalfband *hb, float passband);
+static void qhalfband_deinit(QHalfband *hb);
+static size_t qhalfband_process(QHalfband *hb, int16_t *dst, const int16_t *src, size_t count);
+
+int
+decim_init(Decimator *dec, int stages, float passband)
+{
+	int i;
+
+	dec->count = 0;
+	if (stages <= 0) {
+		dec->stages = NULL;
+		return 0;
+	}
+
+	if (!(dec->stages = calloc(stages, sizeof(*dec->stages)))) return 1;
+	dec->count = stages;
+
+	/* Each stage halves the sample rate, so the passband relative to the
+	 * input of the stage doubles */
+	for (i=0; i<stages; i++, passband *= 2) {
+		if (halfband_init(&dec->stages[i], passband)) return 1;
+	}
+
+	return 0;
+}
+
+void
+decim_deinit(Decimator *dec)
+{
+	int i;
+
+	for (i=0; i<dec->count; i++) {
+		halfband_deinit(&dec->stages[i]);
+	}
+	if (dec->stages) { free(dec->stages); dec->stages=NULL; }
+	dec->count = 0;
+}
+
+size_t
+decim_process(Decimator *dec, float complex *dst, const float complex *src, size_t count)
+{
+	int i;
+
+	if (!dec->count) return 0;
+
+	count = halfband_process(&dec->stages[0], dst, src, count);
+	for (i=1; i<dec->count; i++) {
+		count = halfband_process(&dec->stages[i], dst, dst, count);
+	}
+
+	return count;
+}
+
+int
+qdecim_init(QDecimator *dec, int stages, float passband)
+{
+	int i;
+
+	dec->count = 0;
+	if (stages <= 0) {
+		dec->stages = NULL;
+		return 0;
+	}
+
+	if (!(dec->stages = calloc(stages, sizeof(*dec->stages)))) return 1;
+	dec->count = stages;
+
+	for (i=0; i<stages; i++, passband *= 2) {
+		if (qhalfband_init(&dec->stages[i], passband)) return 1;
+	}
+
+	return 0;
+}
+
+void
+qdecim_deinit(QDecimator *dec)
+{
+	int i;
+
+	for (i=0; i<dec->count; i++) {
+		qhalfband_deinit(&dec->stages[i]);
+	}
+	if (dec->stages) { free(dec->stages); dec->stages=NULL; }
+	dec->count = 0;
+}
+
+size_t
+qdecim_process(QDecimator *dec, int16_t *dst, const int16_t *src, size_t count)
+{
+	int i;
+
+	if (!dec->count) return 0;
+
+	count = qhalfband_process(&dec->stages[0], dst, src, count);
+	for (i=1; i<dec->count; i++) {
+		count = qhalfband_process(&dec->stages[i], dst, dst, count);
+	}
+
+	return count;
+}
+
+/* Static functions {{{ */
+/**
+ * Design a half-band filter, choosing the number of taps based on how wide the
+ * transition band is (the narrower, the more taps are required)
+ *
+ * @return newly allocated array of side non-zero taps, h[1], h[3], h[5]...
+ */
+static float*
+halfband_design(float passband, int *side)
+{
+	const float transition = MAX(0.5 - 2*passband, 0.01);
+	float *coeffs;
+	int i, k, m;
+	float x;
+
+	*side = ceilf(1.5 / transition);
+	*side = MAX(MIN_SIDE_TAPS, MIN(MAX_SIDE_TAPS, *side));
+	m = 2 * *side - 1;
+
+	if (!(coeffs = malloc(sizeof(*coeffs) * *side))) return NULL;
+
+	/* Blackman-windowed sinc with cutoff at fs/4. All even taps except the
+	 * center one are zero, and the center tap is 0.5 */
+	for (i=0; i<*side; i++) {
+		k = 2*i + 1;
+		x = k/2.0;
+		coeffs[i] = 0.5 * sinf(M_PI*x)/(M_PI*x)
+		          * (0.42 + 0.5*cosf(M_PI*k/(m+1)) + 0.08*cosf(2*M_PI*k/(m+1)));
+	}
+
+	return coeffs;
+}
+
+static int
+halfband_init(Halfband *hb, float passband)
+{
+	if (!(hb->coeffs = halfband_design(passband, &hb->side))) return 1;
+
+	hb->size = 2*(2*hb->side - 1) + 1;
+	hb->idx = 0;
+	hb->phase = 0;
+
+	if (!(hb->mem = calloc(2*hb->size, sizeof(*hb->mem)))) return 1;
+
+	return 0;
+}
+
+static void
+halfband_deinit(Halfband *hb)
+{
+	if (hb->coeffs) { free(hb->coeffs); hb->coeffs=NULL; }
+	if (hb->mem) { free(hb->mem); hb->mem=NULL; }
+}
+
+static size_t
+halfband_process(Halfband *hb, float complex *dst, const float complex *src, size_t count)
+{
+	const int center = hb->size/2;
+	const float complex *window;
+	float complex acc;
+	size_t i, produced;
+	int j;
+
+	produced = 0;
+	for (i=0; i<count; i++) {
+		/* Mirrored delay line: the last size samples always start at idx */
+		hb->mem[hb->idx] = hb->mem[hb->idx + hb->size] = src[i];
+		hb->idx = (hb->idx + 1 < hb->size) ? hb->idx + 1 : 0;
+
+		/* Only compute every other output */
+		hb->phase ^= 1;
+		if (hb->phase) continue;
+
+		window = hb->mem + hb->idx;
+		acc = 0.5f * window[center];
+		for (j=0; j<hb->side; j++) {
+			acc += hb->coeffs[j] * (window[center - 2*j - 1] + window[center + 2*j + 1]);
+		}
+		dst[produced++] = acc;
+	}
+
+	return produced;
+}
+static int
+qhalfband_init(QHalfband *hb, float passband)
+{
+	float *coeffs, sum;
+	int i, shift;
+
+	if (!(coeffs = halfband_design(passband, &hb->side))) return 1;
+
+	/* Pick the largest scale factor that keeps the accumulators within 32
+	 * bits, regardless of the input */
+	sum = 0.5;
+	for (i=0; i<hb->side; i++) {
+		sum += 2*fabsf(coeffs[i]);
+	}
+	for (shift=15; shift>1 && sum * (1 << shift) >= INT16_MAX * 2; shift--)
+		;
+
+	hb->shift = shift;
+	hb->idx = hb->center_idx = 0;
+	hb->phase = 0;
+	hb->coeffs = malloc(sizeof(*hb->coeffs) * hb->side);
+	hb->mem_re = calloc(4*hb->side, sizeof(*hb->mem_re));
+	hb->mem_im = calloc(4*hb->side, sizeof(*hb->mem_im));
+	hb->center_re = calloc(hb->side, sizeof(*hb->center_re));
+	hb->center_im = calloc(hb->side, sizeof(*hb->center_im));
+	if (!hb->coeffs || !hb->mem_re || !hb->mem_im || !hb->center_re || !hb->center_im) {
+		free(coeffs);
+		return 1;
+	}
+
+	for (i=0; i<hb->side; i++) {
+		hb->coeffs[i] = lrintf(coeffs[i] * (1 << shift));
+	}
+
+	free(coeffs);
+	return 0;
+}
+
+static void
+qhalfband_deinit(QHalfband *hb)
+{
+	if (hb->coeffs) { free(hb->coeffs); hb->coeffs=NULL; }
+	if (hb->mem_re) { free(hb->mem_re); hb->mem_re=NULL; }
+	if (hb->mem_im) { free(hb->mem_im); hb->mem_im=NULL; }
+	if (hb->center_re) { free(hb->center_re); hb->center_re=NULL; }
+	if (hb->center_im) { free(hb->center_im); hb->center_im=NULL; }
+}
+
+static size_t
+qhalfband_process(QHalfband *hb, int16_t *dst, const int16_t *src, size_t count)
+{
+	const int side = hb->side;
+	const int size = 2*side;
+	const int16_t *restrict win_re, *restrict win_im;
+	int32_t re, im;
+	size_t i, produced;
+	int j;
+
+	produced = 0;
+	for (i=0; i<count; i++) {
+		hb->phase ^= 1;
+		if (hb->phase) {
+			/* Center branch. The oldest sample in here is the one lined up
+			 * with the center of the odd branch */
+			hb->center_re[hb->center_idx] = src[2*i];
+			hb->center_im[hb->center_idx] = src[2*i+1];
+			hb->center_idx = (hb->center_idx + 1 < side) ? hb->center_idx + 1 : 0;
+			continue;
+		}
+
+		/* Odd branch, mirrored delay line like the float version */
+		hb->mem_re[hb->idx] = hb->mem_re[hb->idx + size] = src[2*i];
+		hb->mem_im[hb->idx] = hb->mem_im[hb->idx + size] = src[2*i+1];
+		hb->idx = (hb->idx + 1 < size) ? hb->idx + 1 : 0;
+
+		win_re = hb->mem_re + hb->idx;
+		win_im = hb->mem_im + hb->idx;
+
+		/* Center tap is 0.5, plus 0.5 LSB for rounding */
+		re = (hb->center_re[hb->center_idx] << (hb->shift - 1)) + (1 << (hb->shift - 1));
+		im = (hb->center_im[hb->center_idx] << (hb->shift - 1)) + (1 << (hb->shift - 1));
+		for (j=0; j<side; j++) {
+			re += hb->coeffs[j] * (win_re[side - j - 1] + win_re[side + j]);
+			im += hb->coeffs[j] * (win_im[side - j - 1] + win_im[side + j]);
+		}
+
+		re >>= hb->shift;
+		im >>= hb->shift;
+		dst[2*produced] = Q15_SATURATE(re);
+		dst[2*produced+1] = Q15_SATURATE(im);
+		produced++;
+	}
+
+	return produced;
+}
+/* }}} */
@@ -0,0 +1,101 @@
+#ifndef decim_h
+#define decim_h
+#include <complex.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "q15.h"
+
+typedef struct {
+	float *coeffs;          /* Non-zero taps on one side: h[1], h[3], h[5]... */
+	float complex *mem;     /* Mirrored delay line */
+	int side;               /* Number of non-zero taps on each side */
+	int size;               /* Number of taps */
+	int idx;
+	int phase;
+} Halfband;
+
+typedef struct {
+	Halfband *stages;
+	int count;
+} Decimator;
+
+/**
+ * Initialize a chain of half-band decimate-by-2 filters
+ *
+ * @param dec decimator object to initialize
+ * @param stages number of stages (total decimation factor = 2**stages)
+ * @param passband one-sided bandwidth of the signal to preserve, normalized to
+ *        the input sample rate (e.g. 0.05 = samplerate/20)
+ * @return 0 on success, 1 on failure
+ */
+int decim_init(Decimator *dec, int stages, float passband);
+
+/**
+ * Deinitialize a decimator object
+ *
+ * @param dec decimator to deinitialize
+ */
+void decim_deinit(Decimator *dec);
+
+/**
+ * Decimate a block of samples. Can operate in-place (dst == src)
+ *
+ * @param dec decimator to use
+ * @param dst buffer to write the decimated samples to. Must be able to hold at
+ *        least count/2**stages + 1 samples
+ * @param src input samples
+ * @param count number of samples in src
+ * @return number of samples written to dst
+ */
+size_t decim_process(Decimator *dec, float complex *dst, const float complex *src, size_t count);
+
+/* Fixed-point version of the above. Since all even taps except the center one
+ * are zero, the input is split in two polyphase branches: one going through
+ * the non-zero taps, and one that is just delayed to line up with the center */
+typedef struct {
+	int16_t *coeffs;                /* Same as Halfband, Q(shift) */
+	int16_t *mem_re, *mem_im;       /* Mirrored delay line, odd branch (2*side samples) */
+	int16_t *center_re, *center_im;  /* Delay line, center branch (side samples) */
+	int side;
+	int idx, center_idx;
+	int phase;
+	int shift;
+} QHalfband;
+
+typedef struct {
+	QHalfband *stages;
+	int count;
+} QDecimator;
+
+/**
+ * Initialize a chain of fixed-point half-band decimate-by-2 filters
+ *
+ * @param dec decimator object to initialize
+ * @param stages number of stages (total decimation factor = 2**stages)
+ * @param passband one-sided bandwidth of the signal to preserve, normalized to
+ *        the input sample rate (e.g. 0.05 = samplerate/20)
+ * @return 0 on success, 1 on failure
+ */
+int qdecim_init(QDecimator *dec, int stages, float passband);
+
+/**
+ * Deinitialize a fixed-point decimator object
+ *
+ * @param dec decimator to deinitialize
+ */
+void qdecim_deinit(QDecimator *dec);
+
+/**
+ * Decimate a block of interleaved 16-bit I/Q samples. Can operate in-place
+ * (dst == src)
+ *
+ * @param dec decimator to use
+ * @param dst buffer to write the decimated samples to. Must be able to hold at
+ *        least count/2**stages + 1 I/Q pairs
+ * @param src input samples
+ * @param count number of I/Q pairs in src
+ * @return number of I/Q pairs written to dst
+ */
+size_t qdecim_process(QDecimator *dec, int16_t *dst, const int16_t *src, size_t count);
+
+#endif
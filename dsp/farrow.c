@@ -0,0 +1,29 @@
+#include "farrow.h"
+
+void
+farrow_init(Farrow *farrow)
+{
+	int i;
+
+	for (i=0; i<4; i++) {
+		farrow->hist[i] = 0;
+	}
+}
+
+float complex
+farrow_get(const Farrow *farrow, float mu)
+{
+	const float complex x0 = farrow->hist[0];
+	const float complex x1 = farrow->hist[1];
+	const float complex x2 = farrow->hist[2];
+	const float complex x3 = farrow->hist[3];
+	const float t = 1 - mu;     /* Position relative to x1 */
+	float complex c1, c2, c3;
+
+	/* Lagrange polynomial through x0..x3 at t=-1..2, in powers of t */
+	c1 = x2 - x1/2 - x0/3 - x3/6;
+	c2 = (x0 + x2)/2 - x1;
+	c3 = (x3 - x0)/6 + (x1 - x2)/2;
+
+	return ((c3*t + c2)*t + c1)*t + x1;
+}
@@ -0,0 +1,48 @@
+#ifndef farrow_h
+#define farrow_h
+#include <complex.h>
+
+/* Cubic Lagrange interpolator, evaluated with the Farrow structure: the
+ * polynomial coefficients are computed from the last 4 samples, then
+ * evaluated at the requested fractional delay with Horner's method. Gives
+ * continuous timing resolution at a fixed cost per output, unlike a polyphase
+ * filter bank whose resolution is limited by its number of branches */
+typedef struct {
+	float complex hist[4];      /* Last 4 samples, oldest first */
+} Farrow;
+
+/**
+ * Initialize a cubic interpolator
+ *
+ * @param farrow interpolator object to initialize
+ */
+void farrow_init(Farrow *farrow);
+
+/**
+ * Feed a sample to the interpolator
+ *
+ * @param farrow interpolator to feed
+ * @param sample sample to feed
+ */
+static inline void
+farrow_push(Farrow *farrow, float complex sample)
+{
+	farrow->hist[0] = farrow->hist[1];
+	farrow->hist[1] = farrow->hist[2];
+	farrow->hist[2] = farrow->hist[3];
+	farrow->hist[3] = sample;
+}
+
+/**
+ * Interpolate between the two middle samples in the history. The output is
+ * delayed by one sample with respect to the last one fed, so that there are
+ * always two samples on each side of the interpolation point
+ *
+ * @param farrow interpolator to use
+ * @param mu how long ago the output should have been sampled, as a fraction
+ *        of the sample period, in [0, 1)
+ * @return interpolated sample
+ */
+float complex farrow_get(const Farrow *farrow, float mu);
+
+#endif
@@ -0,0 +1,51 @@
+#include <complex.h>
+#include <math.h>
+#include "fft.h"
+
+static void bit_reverse(float complex *data, unsigned n);
+
+void
+fft(float complex *data, unsigned n)
+{
+	float complex w, wm, t, u;
+	unsigned len, i, j;
+
+	bit_reverse(data, n);
+
+	/* Iterative Cooley-Tukey, decimation in time */
+	for (len=2; len<=n; len <<= 1) {
+		wm = cexpf(-2*I*M_PI/len);
+		for (i=0; i<n; i+=len) {
+			w = 1;
+			for (j=0; j<len/2; j++) {
+				t = w * data[i + j + len/2];
+				u = data[i + j];
+				data[i + j] = u + t;
+				data[i + j + len/2] = u - t;
+				w *= wm;
+			}
+		}
+	}
+}
+
+/* Static functions {{{ */
+static void
+bit_reverse(float complex *data, unsigned n)
+{
+	float complex tmp;
+	unsigned i, j, bit;
+
+	for (i=1, j=0; i<n; i++) {
+		for (bit = n >> 1; j & bit; bit >>= 1) {
+			j ^= bit;
+		}
+		j ^= bit;
+
+		if (i < j) {
+			tmp = data[i];
+			data[i] = data[j];
+			data[j] = tmp;
+		}
+	}
+}
+/* }}} */
@@ -0,0 +1,13 @@
+#ifndef fft_h
+#define fft_h
+#include <complex.h>
+
+/**
+ * In-place radix-2 complex FFT
+ *
+ * @param data samples to transform
+ * @param n number of samples, must be a power of 2
+ */
+void fft(float complex *data, unsigned n);
+
+#endif
@@ -4,33 +4,77 @@
 #include "filter.h"
 #include "utils.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FILTER_X86
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/* Coefficient arrays are zero-padded to a multiple of this many taps, so that
+ * the SIMD kernels never need a scalar tail */
+#define SIMD_WIDTH 8
+#define QSIMD_WIDTH 16
+
 float rrc_coeff(int stage_no, unsigned n_taps, float osf, float alpha);
+static float complex dot_generic(const Filter *flt, const float *coeffs);
+#ifdef FILTER_X86
+static float complex dot_sse(const Filter *flt, const float *coeffs);
+static float complex dot_avx2(const Filter *flt, const float *coeffs);
+#elif defined(__ARM_NEON)
+static float complex dot_neon(const Filter *flt, const float *coeffs);
+#endif
+static cint32 qdot_generic(const QFilter *flt, const int16_t *coeffs);
+#ifdef FILTER_X86
+static cint32 qdot_sse2(const QFilter *flt, const int16_t *coeffs);
+static cint32 qdot_avx2(const QFilter *flt, const int16_t *coeffs);
+#elif defined(__ARM_NEON)
+static cint32 qdot_neon(const QFilter *flt, const int16_t *coeffs);
+#endif
 
 int
 filter_init_rrc(Filter *flt, unsigned order, float osf, float alpha, unsigned factor)
 {
 	const unsigned taps = order*2+1;
+	const unsigned stride = (taps + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
 	unsigned i, j;
 
-	if (!(flt->coeffs = malloc(sizeof(*flt->coeffs) * taps * factor))) return 1;
-	if (!(flt->mem = calloc(taps, sizeof(*flt->mem)))) return 1;
+	/* The delay line is mirrored (every sample is written both at idx and at
+	 * idx+taps) so that the last taps samples are always contiguous in memory,
+	 * starting from idx. It's also padded so that a full stride can be read
+	 * from any starting position */
+	if (!(flt->coeffs = calloc(stride * factor, sizeof(*flt->coeffs)))) return 1;
+	if (!(flt->mem_re = calloc(taps + stride, sizeof(*flt->mem_re)))) return 1;
+	if (!(flt->mem_im = calloc(taps + stride, sizeof(*flt->mem_im)))) return 1;
 
 	for (j=0; j<(unsigned)factor; j++) {
 		for (i=0; i<taps; i++) {
-			flt->coeffs[j*taps + i] = rrc_coeff(i*factor + j, taps*factor, osf*factor, alpha);
+			flt->coeffs[j*stride + i] = rrc_coeff(i*factor + j, taps*factor, osf*factor, alpha);
 		}
 	}
 
 	flt->size = taps;
+	flt->stride = stride;
+	flt->idx = 0;
 	flt->interp_factor = factor;
 
+	/* Select the fastest dot product implementation available */
+	flt->dot = dot_generic;
+#ifdef FILTER_X86
+	flt->dot = dot_sse;
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) flt->dot = dot_avx2;
+#elif defined(__ARM_NEON)
+	flt->dot = dot_neon;
+#endif
+
 	return 0;
 }
 
 void
 filter_deinit(Filter *flt)
 {
-	if (flt->mem) { free(flt->mem); flt->mem=NULL; }
+	if (flt->mem_re) { free(flt->mem_re); flt->mem_re=NULL; }
+	if (flt->mem_im) { free(flt->mem_im); flt->mem_im=NULL; }
 	if (flt->coeffs) { free(flt->coeffs); flt->coeffs=NULL; }
 	flt->size = 0;
 }
@@ -38,30 +82,119 @@ filter_deinit(Filter *flt)
 void
 filter_fwd_sample(Filter *flt, float complex sample)
 {
-	flt->mem[flt->idx++] = sample;
-	flt->idx %= flt->size;
+	flt->mem_re[flt->idx] = flt->mem_re[flt->idx + flt->size] = crealf(sample);
+	flt->mem_im[flt->idx] = flt->mem_im[flt->idx + flt->size] = cimagf(sample);
+	flt->idx++;
+	if (flt->idx >= flt->size) flt->idx = 0;
 }
 
 float complex
 filter_get(Filter *flt, unsigned phase)
 {
-	float complex result;
-	int i, j;
+	return flt->dot(flt, flt->coeffs + (flt->interp_factor - phase - 1)*flt->stride);
+}
+
+int
+qfilter_init(QFilter *flt, const float *coeffs, unsigned taps, unsigned factor)
+{
+	const unsigned stride = (taps + QSIMD_WIDTH - 1) / QSIMD_WIDTH * QSIMD_WIDTH;
+	float abs_sum, max_sum, max_coeff;
+	unsigned i, j;
+	int shift;
+
+	/* Find the worst case gain among the branches: scaling the coefficients so
+	 * that it's below 2^16 means that even a full-scale input of the worst
+	 * possible shape cannot overflow the 32-bit accumulators */
+	max_sum = max_coeff = 0;
+	for (j=0; j<factor; j++) {
+		abs_sum = 0;
+		for (i=0; i<taps; i++) {
+			abs_sum += fabsf(coeffs[j*taps + i]);
+			max_coeff = MAX(max_coeff, fabsf(coeffs[j*taps + i]));
+		}
+		max_sum = MAX(max_sum, abs_sum);
+	}
+	for (shift=15; shift>0; shift--) {
+		if (max_sum * (1 << shift) < INT16_MAX * 2 && max_coeff * (1 << shift) < INT16_MAX) break;
+	}
 
-	result = 0;
-	j = (flt->interp_factor - phase - 1)*flt->size;
+	if (!(flt->coeffs = calloc(stride * factor, sizeof(*flt->coeffs)))) return 1;
+	if (!(flt->mem_re = calloc(taps + stride, sizeof(*flt->mem_re)))) return 1;
+	if (!(flt->mem_im = calloc(taps + stride, sizeof(*flt->mem_im)))) return 1;
 
-	/* Chunk 1: from current position to end */
-	for (i=flt->idx; i<flt->size; i++, j++) {
-		result += flt->mem[i] * flt->coeffs[j];
+	for (j=0; j<factor; j++) {
+		for (i=0; i<taps; i++) {
+			flt->coeffs[j*stride + i] = lrintf(coeffs[j*taps + i] * (1 << shift));
+		}
 	}
 
-	/* Chunk 2: from start to current position - 1 */
-	for (i=0; i<flt->idx; i++, j++) {
-		result += flt->mem[i] * flt->coeffs[j];
+	flt->size = taps;
+	flt->stride = stride;
+	flt->idx = 0;
+	flt->interp_factor = factor;
+	flt->shift = shift;
+
+	flt->dot = qdot_generic;
+#ifdef FILTER_X86
+	if (__builtin_cpu_supports("sse2")) flt->dot = qdot_sse2;
+	if (__builtin_cpu_supports("avx2")) flt->dot = qdot_avx2;
+#elif defined(__ARM_NEON)
+	flt->dot = qdot_neon;
+#endif
+
+	return 0;
+}
+
+int
+qfilter_init_rrc(QFilter *flt, unsigned order, float osf, float alpha, unsigned factor)
+{
+	const unsigned taps = order*2+1;
+	float *coeffs;
+	unsigned i, j;
+	int ret;
+
+	if (!(coeffs = malloc(sizeof(*coeffs) * taps * factor))) return 1;
+
+	for (j=0; j<factor; j++) {
+		for (i=0; i<taps; i++) {
+			coeffs[j*taps + i] = rrc_coeff(i*factor + j, taps*factor, osf*factor, alpha);
+		}
 	}
 
-	return result;
+	ret = qfilter_init(flt, coeffs, taps, factor);
+	free(coeffs);
+	return ret;
+}
+
+void
+qfilter_deinit(QFilter *flt)
+{
+	if (flt->mem_re) { free(flt->mem_re); flt->mem_re=NULL; }
+	if (flt->mem_im) { free(flt->mem_im); flt->mem_im=NULL; }
+	if (flt->coeffs) { free(flt->coeffs); flt->coeffs=NULL; }
+	flt->size = 0;
+}
+
+void
+qfilter_fwd_sample(QFilter *flt, int16_t re, int16_t im)
+{
+	flt->mem_re[flt->idx] = flt->mem_re[flt->idx + flt->size] = re;
+	flt->mem_im[flt->idx] = flt->mem_im[flt->idx + flt->size] = im;
+	flt->idx++;
+	if (flt->idx >= flt->size) flt->idx = 0;
+}
+
+cint32
+qfilter_get(QFilter *flt, unsigned phase)
+{
+	const int32_t round = (1 << flt->shift) >> 1;
+	cint32 acc;
+
+	acc = flt->dot(flt, flt->coeffs + (flt->interp_factor - phase - 1)*flt->stride);
+	acc.re = (acc.re + round) >> flt->shift;
+	acc.im = (acc.im + round) >> flt->shift;
+
+	return acc;
 }
 
 /*Static functions {{{*/
@@ -92,4 +225,203 @@ rrc_coeff(int stage_no, unsigned taps, float osf, float alpha)
 
 	return  coeff / interm * norm;
 }
+
+/* Dot product between the delay line and a polyphase branch. The window always
+ * starts at idx thanks to the mirrored delay line, so each kernel is a single
+ * contiguous loop over stride taps */
+static float complex
+dot_generic(const Filter *flt, const float *coeffs)
+{
+	const float *re = flt->mem_re + flt->idx;
+	const float *im = flt->mem_im + flt->idx;
+	float acc_re, acc_im;
+	int i;
+
+	acc_re = acc_im = 0;
+	for (i=0; i<flt->stride; i++) {
+		acc_re += re[i] * coeffs[i];
+		acc_im += im[i] * coeffs[i];
+	}
+
+	return acc_re + I*acc_im;
+}
+
+#ifdef FILTER_X86
+__attribute__((target("sse")))
+static float complex
+dot_sse(const Filter *flt, const float *coeffs)
+{
+	const float *re = flt->mem_re + flt->idx;
+	const float *im = flt->mem_im + flt->idx;
+	__m128 acc_re, acc_im, c;
+	float tmp_re[4], tmp_im[4];
+	int i;
+
+	acc_re = acc_im = _mm_setzero_ps();
+	for (i=0; i<flt->stride; i+=4) {
+		c = _mm_loadu_ps(coeffs + i);
+		acc_re = _mm_add_ps(acc_re, _mm_mul_ps(_mm_loadu_ps(re + i), c));
+		acc_im = _mm_add_ps(acc_im, _mm_mul_ps(_mm_loadu_ps(im + i), c));
+	}
+
+	_mm_storeu_ps(tmp_re, acc_re);
+	_mm_storeu_ps(tmp_im, acc_im);
+	return (tmp_re[0] + tmp_re[1] + tmp_re[2] + tmp_re[3]) +
+	     I*(tmp_im[0] + tmp_im[1] + tmp_im[2] + tmp_im[3]);
+}
+
+__attribute__((target("avx2,fma")))
+static float complex
+dot_avx2(const Filter *flt, const float *coeffs)
+{
+	const float *re = flt->mem_re + flt->idx;
+	const float *im = flt->mem_im + flt->idx;
+	__m256 acc_re, acc_im, c;
+	__m128 sum_re, sum_im;
+	int i;
+
+	acc_re = acc_im = _mm256_setzero_ps();
+	for (i=0; i<flt->stride; i+=8) {
+		c = _mm256_loadu_ps(coeffs + i);
+		acc_re = _mm256_fmadd_ps(_mm256_loadu_ps(re + i), c, acc_re);
+		acc_im = _mm256_fmadd_ps(_mm256_loadu_ps(im + i), c, acc_im);
+	}
+
+	/* Horizontal sum of both accumulators at once */
+	sum_re = _mm_add_ps(_mm256_castps256_ps128(acc_re), _mm256_extractf128_ps(acc_re, 1));
+	sum_im = _mm_add_ps(_mm256_castps256_ps128(acc_im), _mm256_extractf128_ps(acc_im, 1));
+	sum_re = _mm_hadd_ps(sum_re, sum_im);   /* re01 re23 im01 im23 */
+	sum_re = _mm_hadd_ps(sum_re, sum_re);   /* re   im   re   im   */
+
+	return _mm_cvtss_f32(sum_re) + I*_mm_cvtss_f32(_mm_shuffle_ps(sum_re, sum_re, 1));
+}
+#elif defined(__ARM_NEON)
+static float complex
+dot_neon(const Filter *flt, const float *coeffs)
+{
+	const float *re = flt->mem_re + flt->idx;
+	const float *im = flt->mem_im + flt->idx;
+	float32x4_t acc_re, acc_im, c;
+	float32x2_t sum_re, sum_im;
+	int i;
+
+	acc_re = acc_im = vdupq_n_f32(0);
+	for (i=0; i<flt->stride; i+=4) {
+		c = vld1q_f32(coeffs + i);
+		acc_re = vmlaq_f32(acc_re, vld1q_f32(re + i), c);
+		acc_im = vmlaq_f32(acc_im, vld1q_f32(im + i), c);
+	}
+
+	sum_re = vadd_f32(vget_low_f32(acc_re), vget_high_f32(acc_re));
+	sum_im = vadd_f32(vget_low_f32(acc_im), vget_high_f32(acc_im));
+	sum_re = vpadd_f32(sum_re, sum_im);
+
+	return vget_lane_f32(sum_re, 0) + I*vget_lane_f32(sum_re, 1);
+}
+#endif
+
+static cint32
+qdot_generic(const QFilter *flt, const int16_t *coeffs)
+{
+	const int16_t *re = flt->mem_re + flt->idx;
+	const int16_t *im = flt->mem_im + flt->idx;
+	cint32 acc;
+	int i;
+
+	acc.re = acc.im = 0;
+	for (i=0; i<flt->stride; i++) {
+		acc.re += re[i] * coeffs[i];
+		acc.im += im[i] * coeffs[i];
+	}
+
+	return acc;
+}
+
+#ifdef FILTER_X86
+__attribute__((target("sse2")))
+static cint32
+qdot_sse2(const QFilter *flt, const int16_t *coeffs)
+{
+	const int16_t *re = flt->mem_re + flt->idx;
+	const int16_t *im = flt->mem_im + flt->idx;
+	__m128i acc_re, acc_im, c, sum;
+	cint32 acc;
+	int i;
+
+	/* pmaddwd: 8 16x16 bit products, summed in pairs into 4 32-bit lanes */
+	acc_re = acc_im = _mm_setzero_si128();
+	for (i=0; i<flt->stride; i+=8) {
+		c = _mm_loadu_si128((const __m128i*)(coeffs + i));
+		acc_re = _mm_add_epi32(acc_re, _mm_madd_epi16(_mm_loadu_si128((const __m128i*)(re + i)), c));
+		acc_im = _mm_add_epi32(acc_im, _mm_madd_epi16(_mm_loadu_si128((const __m128i*)(im + i)), c));
+	}
+
+	/* Horizontal sums: re0+re1 re2+re3 im0+im1 im2+im3 -> re im */
+	sum = _mm_add_epi32(_mm_unpacklo_epi64(acc_re, acc_im), _mm_unpackhi_epi64(acc_re, acc_im));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+	acc.re = _mm_cvtsi128_si32(sum);
+	acc.im = _mm_cvtsi128_si32(_mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 2, 2, 2)));
+
+	return acc;
+}
+
+__attribute__((target("avx2")))
+static cint32
+qdot_avx2(const QFilter *flt, const int16_t *coeffs)
+{
+	const int16_t *re = flt->mem_re + flt->idx;
+	const int16_t *im = flt->mem_im + flt->idx;
+	__m256i acc_re, acc_im, c;
+	__m128i sum_re, sum_im, sum;
+	cint32 acc;
+	int i;
+
+	acc_re = acc_im = _mm256_setzero_si256();
+	for (i=0; i<flt->stride; i+=16) {
+		c = _mm256_loadu_si256((const __m256i*)(coeffs + i));
+		acc_re = _mm256_add_epi32(acc_re, _mm256_madd_epi16(_mm256_loadu_si256((const __m256i*)(re + i)), c));
+		acc_im = _mm256_add_epi32(acc_im, _mm256_madd_epi16(_mm256_loadu_si256((const __m256i*)(im + i)), c));
+	}
+
+	sum_re = _mm_add_epi32(_mm256_castsi256_si128(acc_re), _mm256_extracti128_si256(acc_re, 1));
+	sum_im = _mm_add_epi32(_mm256_castsi256_si128(acc_im), _mm256_extracti128_si256(acc_im, 1));
+	sum = _mm_hadd_epi32(sum_re, sum_im);   /* re01 re23 im01 im23 */
+	sum = _mm_hadd_epi32(sum, sum);         /* re   im   re   im   */
+	acc.re = _mm_cvtsi128_si32(sum);
+	acc.im = _mm_extract_epi32(sum, 1);
+
+	return acc;
+}
+#elif defined(__ARM_NEON)
+static cint32
+qdot_neon(const QFilter *flt, const int16_t *coeffs)
+{
+	const int16_t *re = flt->mem_re + flt->idx;
+	const int16_t *im = flt->mem_im + flt->idx;
+	int32x4_t acc_re, acc_im;
+	int32x2_t sum;
+	int16x8_t c, x, y;
+	cint32 acc;
+	int i;
+
+	/* vmlal: widening 16x16->32 bit multiply-accumulate, 4 lanes at a time */
+	acc_re = acc_im = vdupq_n_s32(0);
+	for (i=0; i<flt->stride; i+=8) {
+		c = vld1q_s16(coeffs + i);
+		x = vld1q_s16(re + i);
+		y = vld1q_s16(im + i);
+		acc_re = vmlal_s16(acc_re, vget_low_s16(x), vget_low_s16(c));
+		acc_re = vmlal_s16(acc_re, vget_high_s16(x), vget_high_s16(c));
+		acc_im = vmlal_s16(acc_im, vget_low_s16(y), vget_low_s16(c));
+		acc_im = vmlal_s16(acc_im, vget_high_s16(y), vget_high_s16(c));
+	}
+
+	sum = vpadd_s32(vadd_s32(vget_low_s32(acc_re), vget_high_s32(acc_re)),
+	                vadd_s32(vget_low_s32(acc_im), vget_high_s32(acc_im)));
+	acc.re = vget_lane_s32(sum, 0);
+	acc.im = vget_lane_s32(sum, 1);
+
+	return acc;
+}
+#endif
 /*}}}*/
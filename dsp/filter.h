@@ -1,12 +1,16 @@
 #ifndef filter_h
 #define filter_h
 #include <complex.h>
+#include <stdint.h>
+#include "q15.h"
 
-typedef struct {
-	float complex *mem;
+typedef struct Filter {
+	float *mem_re, *mem_im;     /* Mirrored delay line, split into I and Q */
 	float *coeffs;
+	float complex (*dot)(const struct Filter *flt, const float *coeffs);
 	int interp_factor;
-	int size;
+	int size;                   /* Number of taps */
+	int stride;                 /* Number of taps, padded to the SIMD width */
 	int idx;
 } Filter;
 
@@ -48,4 +52,70 @@ void filter_fwd_sample(Filter *flt, float complex sample);
  */
 float complex filter_get(Filter *flt, unsigned phase);
 
+/* Fixed-point version of the above, operating on 16-bit integer samples */
+typedef struct QFilter {
+	int16_t *mem_re, *mem_im;   /* Mirrored delay line, split into I and Q */
+	int16_t *coeffs;
+	cint32 (*dot)(const struct QFilter *flt, const int16_t *coeffs);
+	int interp_factor;
+	int size;                   /* Number of taps */
+	int stride;                 /* Number of taps, padded to the SIMD width */
+	int idx;
+	int shift;                  /* Number of fractional bits in the coefficients */
+} QFilter;
+
+/**
+ * Initialize a fixed-point FIR filter. The coefficients are scaled by the
+ * largest power of two (up to 2^15) that guarantees the 32-bit accumulators
+ * never overflow, regardless of the input
+ *
+ * @param flt filter object to initialize
+ * @param coeffs floating point coefficients, one branch after the other
+ *        (coeffs[branch*taps + tap])
+ * @param taps number of taps in each branch
+ * @param factor interpolation factor (number of branches)
+ *
+ * @return 0 on success, 1 on failure
+ */
+int qfilter_init(QFilter *flt, const float *coeffs, unsigned taps, unsigned factor);
+
+/**
+ * Initialize a fixed-point FIR filter with the same response as
+ * filter_init_rrc() would
+ *
+ * @param flt filter object to initialize
+ * @param order order of the filter (e.g. 16 = 16 + 1 + 16 taps)
+ * @param osf oversampling factor (samples per symbol)
+ * @param alpha filter alpha parameter
+ * @param factor interpolation factor
+ *
+ * @return 0 on success, 1 on failure
+ */
+int qfilter_init_rrc(QFilter *flt, unsigned order, float osf, float alpha, unsigned factor);
+
+/**
+ * Deinitialize a fixed-point filter object
+ *
+ * @param flt filter to deinitalize
+ */
+void qfilter_deinit(QFilter *flt);
+
+/**
+ * Feed a sample to a fixed-point filter object
+ *
+ * @param flt filter to pass the sample through
+ * @param re in-phase component of the sample
+ * @param im quadrature component of the sample
+ */
+void qfilter_fwd_sample(QFilter *flt, int16_t re, int16_t im);
+
+/**
+ * Get the output of a fixed-point filter object
+ *
+ * @param flt filter to read the sample from
+ * @param phase for interpolating filters, the phase to fetch the sample from
+ * @return filter output, in the same units as the input
+ */
+cint32 qfilter_get(QFilter *flt, unsigned phase);
+
 #endif
@@ -0,0 +1,177 @@
+#include <complex.h>
+#include <math.h>
+#include "nco.h"
+#include "utils.h"
+
+#define LANES 4
+#define RAD_TO_PHASE (4294967296.0 / (2*M_PI))
+#define MAX_NUDGE 1.0f      /* Largest phase adjustment small_rotation() can handle */
+
+static float complex cmul(float complex x, float complex y);
+static float complex renorm(float complex x);
+static float complex small_rotation(float delta);
+
+void
+nco_init(Nco *nco, float freq)
+{
+	nco->phasor = 1;
+	nco->count = 0;
+	nco_set_freq(nco, freq);
+}
+
+void
+nco_set_freq(Nco *nco, float freq)
+{
+	nco->step = cosf(freq) + I*sinf(freq);
+}
+
+void
+nco_adjust_freq(Nco *nco, float delta)
+{
+	const float re = crealf(nco->step);
+	const float im = cimagf(nco->step);
+
+	/* First order is plenty for the tiny corrections coming from a loop filter,
+	 * and the magnitude error is removed by the periodic renormalization */
+	nco->step = (re - delta*im) + I*(im + delta*re);
+}
+
+void
+nco_adjust_phase(Nco *nco, float delta)
+{
+	/* Past this, the rotation is so far from unit magnitude that renorm()
+	 * diverges instead of correcting it. Only happens with the huge errors
+	 * seen before the AGC has settled */
+	delta = MAX(-MAX_NUDGE, MIN(MAX_NUDGE, delta));
+	nco->phasor = renorm(cmul(nco->phasor, small_rotation(delta)));
+}
+
+void
+nco_renorm(Nco *nco)
+{
+	nco->phasor = renorm(nco->phasor);
+	nco->step = renorm(nco->step);
+	nco->count = 0;
+}
+
+void
+qnco_init(QNco *nco, float freq)
+{
+	int i;
+
+	for (i=0; i<(int)LEN(nco->lut); i++) {
+		nco->lut[i] = lrint(sin(2*M_PI*i/QNCO_LUT_SIZE) * INT16_MAX);
+	}
+
+	nco->phase = 0;
+	qnco_set_freq(nco, freq);
+}
+
+void
+qnco_set_freq(QNco *nco, float freq)
+{
+	nco->step = (uint32_t)llrint(freq * RAD_TO_PHASE);
+}
+
+void
+qnco_adjust_phase(QNco *nco, float delta)
+{
+	nco->phase += (uint32_t)llrint(delta * RAD_TO_PHASE);
+}
+
+cint32
+qnco_mix(QNco *nco, cint32 sample)
+{
+	const uint32_t idx = (nco->phase + (1U << (31 - QNCO_LUT_BITS))) >> (32 - QNCO_LUT_BITS);
+	const int32_t sine = nco->lut[idx];
+	const int32_t cosine = nco->lut[idx + QNCO_LUT_SIZE/4];
+	const int32_t round = 1 << 14;
+	cint32 out;
+
+	/* sample * e^(-j*phase), Q15 */
+	out.re = (sample.re*cosine + sample.im*sine + round) >> 15;
+	out.im = (sample.im*cosine - sample.re*sine + round) >> 15;
+	nco->phase += nco->step;
+
+	return out;
+}
+
+void
+nco_mix_block(Nco *nco, float complex *dst, const float complex *src, size_t count)
+{
+	float lo_re[LANES], lo_im[LANES];
+	float complex lane, step_n;
+	float re, im, tmp;
+	size_t i, end;
+	int j;
+
+	/* Run LANES independent oscillators, each one sample apart and advancing by
+	 * LANES samples at a time. This breaks the dependency chain between
+	 * consecutive samples, allowing the loop to be vectorized */
+	lane = nco->phasor;
+	step_n = 1;
+	for (j=0; j<LANES; j++) {
+		lo_re[j] = crealf(lane);
+		lo_im[j] = cimagf(lane);
+		lane = cmul(lane, nco->step);
+		step_n = cmul(step_n, nco->step);
+	}
+
+	step_n = renorm(step_n);
+
+	for (i=0; i + LANES <= count; ) {
+		end = MIN(count - count%LANES, i + NCO_RENORM_INTERVAL);
+
+		for (; i<end; i += LANES) {
+			for (j=0; j<LANES; j++) {
+				re = crealf(src[i+j]);
+				im = cimagf(src[i+j]);
+				dst[i+j] = (re*lo_re[j] + im*lo_im[j]) + I*(im*lo_re[j] - re*lo_im[j]);
+
+				tmp = lo_re[j]*crealf(step_n) - lo_im[j]*cimagf(step_n);
+				lo_im[j] = lo_re[j]*cimagf(step_n) + lo_im[j]*crealf(step_n);
+				lo_re[j] = tmp;
+			}
+		}
+
+		for (j=0; j<LANES; j++) {
+			lane = renorm(lo_re[j] + I*lo_im[j]);
+			lo_re[j] = crealf(lane);
+			lo_im[j] = cimagf(lane);
+		}
+	}
+
+	/* Resume the scalar oscillator from the first lane, which is exactly i
+	 * samples ahead of where it started */
+	nco->phasor = lo_re[0] + I*lo_im[0];
+	nco->count = 0;
+	for (; i<count; i++) {
+		dst[i] = nco_mix(nco, src[i]);
+	}
+}
+
+/* Static functions {{{ */
+/* Complex multiplication, without the inf/NaN handling required by C99 */
+static float complex
+cmul(float complex x, float complex y)
+{
+	return (crealf(x)*crealf(y) - cimagf(x)*cimagf(y)) + I*(crealf(x)*cimagf(y) + cimagf(x)*crealf(y));
+}
+
+/* Bring a phasor back to unit magnitude. Since |x| ~= 1, a single
+ * Newton-Raphson iteration of 1/sqrt(|x|^2) is enough */
+static float complex
+renorm(float complex x)
+{
+	const float mag2 = crealf(x)*crealf(x) + cimagf(x)*cimagf(x);
+	return x * (1.5f - 0.5f*mag2);
+}
+
+/* Taylor approximation of e^(j*delta), valid for small delta */
+static float complex
+small_rotation(float delta)
+{
+	const float delta2 = delta*delta;
+	return (1 - 0.5f*delta2) + I*delta*(1 - delta2/6);
+}
+/* }}} */
@@ -0,0 +1,145 @@
+#ifndef nco_h
+#define nco_h
+#include <complex.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "q15.h"
+
+/* Number of samples after which the phasor magnitude is corrected. Rounding
+ * errors make it drift away from 1 very slowly, so this can be large */
+#define NCO_RENORM_INTERVAL 256
+
+/* Size of the sine table used by the fixed-point oscillator. The worst case
+ * phase error is pi/2**QNCO_LUT_BITS */
+#define QNCO_LUT_BITS 10
+#define QNCO_LUT_SIZE (1 << QNCO_LUT_BITS)
+
+typedef struct {
+	float complex phasor;       /* Current local oscillator value, e^(j*phase) */
+	float complex step;         /* Rotation applied every sample, e^(j*freq) */
+	unsigned count;             /* Samples since the last renormalization */
+} Nco;
+
+/**
+ * Initialize a numerically controlled oscillator
+ *
+ * @param nco oscillator object to initialize
+ * @param freq initial frequency, in radians per sample
+ */
+void nco_init(Nco *nco, float freq);
+
+/**
+ * Set the frequency of the oscillator. This recomputes the step phasor from
+ * scratch, so it should not be called in the hot path
+ *
+ * @param nco oscillator to update
+ * @param freq new frequency, in radians per sample
+ */
+void nco_set_freq(Nco *nco, float freq);
+
+/**
+ * Nudge the frequency of the oscillator by a small amount
+ *
+ * @param nco oscillator to update
+ * @param delta frequency change, in radians per sample. Must be small (<<1)
+ */
+void nco_adjust_freq(Nco *nco, float delta);
+
+/**
+ * Nudge the phase of the oscillator by a small amount
+ *
+ * @param nco oscillator to update
+ * @param delta phase change, in radians. Should be small (<<1), and is clamped
+ *        to +-1
+ */
+void nco_adjust_phase(Nco *nco, float delta);
+
+/**
+ * Bring the oscillator back to unit magnitude, compensating for the rounding
+ * errors accumulated since the last call
+ *
+ * @param nco oscillator to renormalize
+ */
+void nco_renorm(Nco *nco);
+
+/**
+ * Mix a sample with the oscillator (i.e. multiply it by e^(-j*phase)), then
+ * advance the oscillator by one sample
+ *
+ * @param nco oscillator to use
+ * @param sample sample to mix
+ * @return mixed sample
+ */
+static inline float complex
+nco_mix(Nco *nco, float complex sample)
+{
+	const float lo_re = crealf(nco->phasor);
+	const float lo_im = cimagf(nco->phasor);
+	const float re = crealf(sample);
+	const float im = cimagf(sample);
+
+	/* Products written out explicitly to avoid the inf/NaN handling that C99
+	 * requires for complex multiplication */
+	nco->phasor = (lo_re*crealf(nco->step) - lo_im*cimagf(nco->step))
+	            + I*(lo_re*cimagf(nco->step) + lo_im*crealf(nco->step));
+	if (++nco->count >= NCO_RENORM_INTERVAL) nco_renorm(nco);
+
+	return (re*lo_re + im*lo_im) + I*(im*lo_re - re*lo_im);
+}
+
+/**
+ * Mix a block of samples with the oscillator, advancing it by count samples.
+ * The samples are split across interleaved oscillators stepping by a power of
+ * the step phasor, so that the multiplies are independent of each other and
+ * the loop can be vectorized. The frequency must stay constant over the block,
+ * which rules this out inside the carrier loop, where the oscillator is
+ * corrected after every symbol
+ *
+ * @param nco oscillator to use
+ * @param dst buffer to write the mixed samples to. Can be the same as src
+ * @param src samples to mix
+ * @param count number of samples to mix
+ */
+void nco_mix_block(Nco *nco, float complex *dst, const float complex *src, size_t count);
+
+/* Fixed-point oscillator: 32-bit phase accumulator and Q15 sine table */
+typedef struct {
+	uint32_t phase;     /* 2^32 = 2pi */
+	uint32_t step;
+	int16_t lut[QNCO_LUT_SIZE + QNCO_LUT_SIZE/4];   /* sin(x), extended to cos(x) */
+} QNco;
+
+/**
+ * Initialize a fixed-point numerically controlled oscillator
+ *
+ * @param nco oscillator object to initialize
+ * @param freq initial frequency, in radians per sample
+ */
+void qnco_init(QNco *nco, float freq);
+
+/**
+ * Set the frequency of a fixed-point oscillator
+ *
+ * @param nco oscillator to update
+ * @param freq new frequency, in radians per sample
+ */
+void qnco_set_freq(QNco *nco, float freq);
+
+/**
+ * Nudge the phase of a fixed-point oscillator
+ *
+ * @param nco oscillator to update
+ * @param delta phase change, in radians
+ */
+void qnco_adjust_phase(QNco *nco, float delta);
+
+/**
+ * Mix a sample with a fixed-point oscillator, then advance it by one sample
+ *
+ * @param nco oscillator to use
+ * @param sample sample to mix. Both components must fit in 16 bits
+ * @return mixed sample
+ */
+cint32 qnco_mix(QNco *nco, cint32 sample);
+
+#endif
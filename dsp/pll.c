@@ -1,142 +1,150 @@
 #include <math.h>
 #include "pll.h"
 #include "utils.h"
-#include "sincos.h"
 
 #define FREQ_MAX 0.3f
 #define ERR_POLE 0.001f
 #define M_1_SQRT2 0.7071067811865475f
 
 
-static void update_estimate(float error);
-static void update_alpha_beta(float damp, float bw);
+static void update_estimate(Pll *pll, float error);
+static void set_freq(Pll *pll, float freq);
+static void update_alpha_beta(Pll *pll, float damp, float bw);
 static float compute_error(float re, float im);
 static float lut_tanh(float x);
 
-static float _freq, _phase;
-static float _alpha, _beta;
-static float _lut_tanh[32];
-static float _err;
-static int _locked, _locked_once;
-static float _bw;
-static float _fmax;
+/* tanh(x) for x in [-16, 15] */
+static const float _lut_tanh[32] = {
+	-1.000000000f, -1.000000000f, -1.000000000f, -1.000000000f,
+	-1.000000000f, -1.000000000f, -1.000000000f, -0.999999940f,
+	-0.999999762f, -0.999998331f, -0.999987721f, -0.999909222f,
+	-0.999329329f, -0.995054781f, -0.964027584f, -0.761594176f,
+	 0.000000000f,  0.761594176f,  0.964027584f,  0.995054781f,
+	 0.999329329f,  0.999909222f,  0.999987721f,  0.999998331f,
+	 0.999999762f,  0.999999940f,  1.000000000f,  1.000000000f,
+	 1.000000000f,  1.000000000f,  1.000000000f,  1.000000000f,
+};
 
 void
-pll_init(float bw, int oqpsk, float freq_max)
+pll_init(Pll *pll, float bw, int oqpsk, float freq_max, int fixed)
 {
-	int i;
-
 	/* Use default if freq_max is negative, use 1 if freq_max > 1 */
 	if (freq_max < 0) freq_max = FREQ_MAX;
 	else freq_max = MIN(1.0f, freq_max);
 
-	_freq = 0;
-	_phase = 0;
-	_locked = _locked_once = 0;
-	_err = 1000;
-	_bw = bw;
-	_fmax = (oqpsk ? freq_max/2 : freq_max);
-
-	for (i=0; i<(int)LEN(_lut_tanh); i++) {
-		_lut_tanh[i] = (float)tanh(i-16);
+	pll->freq = 0;
+	pll->fixed = fixed;
+	if (fixed) {
+		qnco_init(&pll->qnco, 0);
+	} else {
+		nco_init(&pll->nco, 0);
 	}
-	update_alpha_beta(M_1_SQRT2, bw);
+	pll->locked = pll->locked_once = 0;
+	pll->err = 1000;
+	pll->bw = bw;
+	pll->fmax = (oqpsk ? freq_max/2 : freq_max);
+	pll->updown = 1;
+	pll->sweep = 1;
+
+	update_alpha_beta(pll, M_1_SQRT2, bw);
 }
 
-float pll_get_freq() { return _freq; }
-int pll_get_locked() { return _locked; }
-int pll_did_lock_once() { return _locked_once; }
+float pll_get_freq(const Pll *pll) { return pll->freq; }
+int pll_get_locked(const Pll *pll) { return pll->locked; }
+int pll_did_lock_once(const Pll *pll) { return pll->locked_once; }
 
-float complex
-pll_mix(float complex sample)
+void
+pll_set_freq(Pll *pll, float freq)
 {
-	const float sine = fast_sin(-_phase);
-	const float cosine = fast_cos(-_phase);
-	const float re = crealf(sample);
-	const float im = cimagf(sample);
-
-	/* Mix sample */
-	sample = (re*cosine - im*sine) + I*(re*sine + im*cosine);
-	_phase += _freq;            /* Advance phase based on frequency */
-	if (_phase >= 2*M_PI) _phase -= 2*M_PI;
+	pll->freq = MAX(-pll->fmax, MIN(pll->fmax, freq));
+	if (pll->fixed) {
+		qnco_set_freq(&pll->qnco, pll->freq);
+	} else {
+		nco_set_freq(&pll->nco, pll->freq);
+	}
+}
 
-	return sample;
+float complex
+pll_mix(Pll *pll, float complex sample)
+{
+	return nco_mix(&pll->nco, sample);
 }
 
 float
-pll_mix_i(float complex sample)
+pll_mix_i(Pll *pll, float complex sample)
 {
-	const float sine = fast_sin(-_phase);
-	const float cosine = fast_cos(-_phase);
-	const float re = crealf(sample);
-	const float im = cimagf(sample);
-	float result;
-
-	/* Mix sample (real part only) */
-	result = re*cosine - im*sine;
-	_phase += _freq;            /* Advance phase based on frequency */
-	if (_phase >= 2*M_PI) _phase -= 2*M_PI;
-
-	return result;
+	return crealf(nco_mix(&pll->nco, sample));
 }
 
 float
-pll_mix_q(float complex sample)
+pll_mix_q(Pll *pll, float complex sample)
 {
-	const float sine = fast_sin(-_phase);
-	const float cosine = fast_cos(-_phase);
-	const float re = crealf(sample);
-	const float im = cimagf(sample);
-	float result;
-
-	result = re*sine + im*cosine;
-	_phase += _freq;            /* Advance phase based on frequency */
-	if (_phase >= 2*M_PI) _phase -= 2*M_PI;
+	return cimagf(nco_mix(&pll->nco, sample));
+}
 
-	return result;
+cint32
+pll_mix_fixed(Pll *pll, cint32 sample)
+{
+	return qnco_mix(&pll->qnco, sample);
 }
 
 void
-pll_update_estimate(float i, float q)
+pll_update_estimate(Pll *pll, float i, float q)
 {
 	float error;
 	error = compute_error(i, q);
 
-	update_estimate(error);
+	update_estimate(pll, error);
 }
 
 /* Static functions {{{ */
 static void
-update_estimate(float error)
+update_estimate(Pll *pll, float error)
 {
-	static int updown = 1;
-	_phase = fmod(_phase + _alpha*error, 2*M_PI);
-	_freq += _beta*error;
+	float freq;
+
+	if (pll->fixed) {
+		qnco_adjust_phase(&pll->qnco, pll->alpha*error);
+	} else {
+		nco_adjust_phase(&pll->nco, pll->alpha*error);
+	}
+	freq = pll->freq + pll->beta*error;
 
 	/* Lock detection */
-	_err = _err*(1-ERR_POLE) + fabs(error)*ERR_POLE;
-	if (_err < 85 && !_locked) {
-		_locked = 1;
-		_locked_once = 1;
-	} else if (_err > 105 && _locked) {
-		_locked = 0;
+	pll->err = pll->err*(1-ERR_POLE) + fabs(error)*ERR_POLE;
+	if (pll->err < 85 && !pll->locked) {
+		pll->locked = 1;
+		pll->locked_once = 1;
+	} else if (pll->err > 105 && pll->locked) {
+		pll->locked = 0;
 	}
 
 	/* If unlocked, scan the frequency range up and down */
-	if (!_locked) _freq += 0.000001 * updown;
-	updown = (_freq >= _fmax) ? -1 : (_freq <= -_fmax) ? 1 : updown;
-	_freq = MAX(-_fmax, MIN(_fmax, _freq));
+	if (!pll->locked && pll->sweep) freq += 0.000001 * pll->updown;
+	pll->updown = (freq >= pll->fmax) ? -1 : (freq <= -pll->fmax) ? 1 : pll->updown;
+	set_freq(pll, MAX(-pll->fmax, MIN(pll->fmax, freq)));
+}
 
+/* Apply a small frequency change to the oscillator without recomputing it */
+static void
+set_freq(Pll *pll, float freq)
+{
+	if (pll->fixed) {
+		qnco_set_freq(&pll->qnco, freq);
+	} else {
+		nco_adjust_freq(&pll->nco, freq - pll->freq);
+	}
+	pll->freq = freq;
 }
 
 static void
-update_alpha_beta(float damp, float bw)
+update_alpha_beta(Pll *pll, float damp, float bw)
 {
 	float denom;
 
 	denom = (1 + 2*damp*bw + bw*bw);
-	_alpha = 4*damp*bw/denom;
-	_beta = 4*bw*bw/denom;
+	pll->alpha = 4*damp*bw/denom;
+	pll->beta = 4*bw*bw/denom;
 }
 
 static float
@@ -150,11 +158,12 @@ compute_error(float re, float im)
 	return err;
 }
 
-float
+static float
 lut_tanh(float val)
 {
-	if (val > 15) return 1;
-	if (val < -16) return -1;
+	/* Negated so that NaN never reaches the table lookup */
+	if (!(val <= 15)) return 1;
+	if (!(val >= -16)) return -1;
 	return _lut_tanh[(int)val+16];
 }
 /* }}} */
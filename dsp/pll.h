@@ -1,63 +1,105 @@
 #ifndef pll_h
 #define pll_h
 #include <complex.h>
+#include "nco.h"
+
+typedef struct {
+	Nco nco;        /* Local oscillator */
+	QNco qnco;      /* Local oscillator, fixed-point mode */
+	int fixed;
+	float freq;
+	float alpha, beta;
+	float err;
+	int locked, locked_once;
+	float bw;
+	float fmax;
+	int updown;
+	int sweep;      /* Whether to scan the frequency range while unlocked */
+} Pll;
 
 /**
  * Initialize phase locked loop
  *
+ * @param pll PLL object to initialize
  * @param bw bandwidth of the loop filter
  * @param oqpsk 0 if QPSK modulation, 1 if OQPSK
  * @param freq_max maximum carrier deviation, in (1/symbol_rate) rad/s
  *        e.g. freq_max=0.3 -> +-3.5kHz @72ksym/s, +-3.8kHz @80ksym/s
+ * @param fixed 0 to mix float samples (pll_mix*), 1 to mix fixed-point samples
+ *        (pll_mix_fixed)
  */
-void  pll_init(float bw, int oqpsk, float freq_max);
+void  pll_init(Pll *pll, float bw, int oqpsk, float freq_max, int fixed);
 
 /**
  * Get the PLL local oscillator frequency
  *
+ * @param pll PLL object to query
  * @return frequency
  */
-float pll_get_freq();
+float pll_get_freq(const Pll *pll);
+
+/**
+ * Override the PLL local oscillator frequency, e.g. with an estimate coming
+ * from a coarse acquisition stage
+ *
+ * @param pll PLL object to update
+ * @param freq new frequency, clipped to the maximum carrier deviation
+ */
+void pll_set_freq(Pll *pll, float freq);
 
 /**
  * Get current PLL status
  *
+ * @param pll PLL object to query
  * @return 0 if unlocked, 1 if locked
  */
-int pll_get_locked();
+int pll_get_locked(const Pll *pll);
 
 /**
  * Check whether the PLL locked at least once in the past
  *
+ * @param pll PLL object to query
  * @return 0 if it never locked, 1 if it did
  */
-int pll_did_lock_once();
+int pll_did_lock_once(const Pll *pll);
 
 /**
  * Update the carrier estimate based on a sample pair
  * (for QPSK, sample = cosample)
  *
+ * @param pll PLL object to update
  * @param i in-phase sample
  * @param q quadrature sample
  */
-void  pll_update_estimate(float i, float q);
+void  pll_update_estimate(Pll *pll, float i, float q);
 
 /**
  * Mix a sample with the local oscillator
  *
+ * @param pll PLL object to use
  * @param sample sample to mix
  * @return PLL output
  */
-float complex pll_mix(float complex sample);
+float complex pll_mix(Pll *pll, float complex sample);
 
 /**
  * Partially mix a sample with the local oscillator, returning only the I branch
  * or the Q branch depending on the function
  *
+ * @param pll PLL object to use
  * @param sample sample to mix
  * @return PLL output (I branch only/Q branch only)
  */
-float pll_mix_i(float complex sample);
-float pll_mix_q(float complex sample);
+float pll_mix_i(Pll *pll, float complex sample);
+float pll_mix_q(Pll *pll, float complex sample);
+
+/**
+ * Mix a fixed-point sample with the local oscillator
+ *
+ * @param pll PLL object to use, initialized in fixed-point mode
+ * @param sample sample to mix. Both components must fit in 16 bits
+ * @return PLL output
+ */
+cint32 pll_mix_fixed(Pll *pll, cint32 sample);
 
 #endif
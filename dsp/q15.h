@@ -0,0 +1,17 @@
+/**
+ * Common definitions for the fixed-point signal path
+ */
+#ifndef q15_h
+#define q15_h
+#include <stdint.h>
+
+#define Q15_ONE 32768
+
+/* Complex integer sample, I/Q components in the same units as the input */
+typedef struct {
+	int32_t re, im;
+} cint32;
+
+#define Q15_SATURATE(x) ((x) > INT16_MAX ? INT16_MAX : (x) < INT16_MIN ? INT16_MIN : (x))
+
+#endif
@@ -1,7 +0,0 @@
-#ifndef sincos_h
-#define sincos_h
-
-float fast_sin(float x);
-float fast_cos(float x);
-
-#endif
@@ -6,84 +6,96 @@
 /* freq will be at most +-2**-FREQ_DEV_EXP outside of the range */
 #define FREQ_DEV_EXP 12
 
-static void update_estimate(float err);
-static void update_alpha_beta(float damp, float bw);
+/* Gain applied to the Gardner error. Its S-curve is about 300 times steeper
+ * than the M&M one at the symbol magnitude the AGC settles on, but matching
+ * that leaves the loop too slow to pull back in after drifting on the noise
+ * that precedes a pass, so it runs about 7 times wider */
+#define GARDNER_GAIN 0.02f
+
+static void update_estimate(Timing *tim, float err);
+static void update_alpha_beta(Timing *tim, float damp, float bw);
 static float mm_err(float prev, float cur);
 
-static float _prev;
-static float _phase, _freq;                /* Symbol phase and rate estimate */
-static float _freq_max_dev, _center_freq;  /* Max freq deviation and center freq */
-static float _alpha, _beta;                /* Proportional and integral loop gain */
-
 void
-timing_init(float sym_freq, float bw)
+timing_init(Timing *tim, float sym_freq, float bw)
 {
-	_freq = sym_freq;
-	_center_freq = _freq;
-	_freq_max_dev = _freq / (1<<FREQ_DEV_EXP);
+	tim->prev = 0;
+	tim->phase = 0;
+	tim->freq = sym_freq;
+	tim->center_freq = tim->freq;
+	tim->freq_max_dev = tim->freq / (1<<FREQ_DEV_EXP);
+	tim->state = 1;
+	tim->prev_sym = tim->mid = tim->prev_mid = 0;
 
 
-	update_alpha_beta(1, bw);
+	update_alpha_beta(tim, 1, bw);
 }
 
-float mm_omega() {return _freq;}
+float mm_omega(const Timing *tim) {return tim->freq;}
 
-int
-advance_timeslot()
+void
+timing_set_freq(Timing *tim, float freq)
 {
-	_phase += _freq;
-
-	/* Check if the timeslot is right */
-	return _phase >= 2*(float)M_PI;
+	tim->freq = MAX(tim->center_freq - tim->freq_max_dev, MIN(tim->center_freq + tim->freq_max_dev, freq));
 }
 
-int
-advance_timeslot_dual()
+void
+retime(Timing *tim, float complex sample)
 {
-	static int state = 1;
-	int ret;
+	float err;
 
-	/* Phase up */
-	_phase += _freq;
+	/* Compute timing error */
+	err = mm_err(tim->prev, cimagf(sample));
+	tim->prev = cimagf(sample);
 
-	/* Check if the timeslot is right */
-	if (_phase >= state * (float)M_PI) {
-		ret = state;
-		state = (state % 2) + 1;
-		return ret;
-	}
+	/* Update phase and freq estimate */
+	update_estimate(tim, err);
+}
 
-	return 0;
+void
+retime_gardner(Timing *tim, float complex sample)
+{
+	float err;
+
+	/* Re{(previous - current) * conj(midpoint)}: the midpoint is only
+	 * nonzero on average if it's off the zero crossing between two symbols */
+	err = crealf(tim->prev_sym - sample) * crealf(tim->mid)
+	    + cimagf(tim->prev_sym - sample) * cimagf(tim->mid);
+	tim->prev_sym = sample;
+
+	update_estimate(tim, GARDNER_GAIN * err);
 }
 
 void
-retime(float complex sample)
+retime_gardner_oqpsk(Timing *tim, float complex sample)
 {
 	float err;
 
-	/* Compute timing error */
-	err = mm_err(_prev, cimagf(sample));
-	_prev = cimagf(sample);
+	/* Same as above, applied to each branch separately: Q symbols fall on
+	 * this sample and the previous one, with the midpoint in between, while
+	 * I symbols fall on the midpoints, with the previous symbol in between */
+	err = cimagf(tim->prev_sym - sample) * cimagf(tim->mid)
+	    + crealf(tim->prev_mid - tim->mid) * crealf(tim->prev_sym);
+	tim->prev_sym = sample;
 
-	/* Update phase and freq estimate */
-	update_estimate(err);
+	update_estimate(tim, GARDNER_GAIN * err);
 }
 
 /* Static functions {{{ */
 static void
-update_estimate(float error)
+update_estimate(Timing *tim, float error)
 {
 	float freq_delta;
 
-	freq_delta = _freq - _center_freq;
+	freq_delta = tim->freq - tim->center_freq;
 
-	_phase -= 2*M_PI + _alpha*error;
-	freq_delta -= _beta*error;
+	tim->phase -= 2*M_PI + tim->alpha*error;
+	freq_delta -= tim->beta*error;
 
-	/* Clip _freq between _freq - _freq_max_dev and _freq + _freq_max_dev */
-	freq_delta = MAX(-_freq_max_dev, MIN(_freq_max_dev, freq_delta));
+	/* Clip freq between center_freq - freq_max_dev and center_freq + freq_max_dev */
+	freq_delta = MAX(-tim->freq_max_dev, MIN(tim->freq_max_dev, freq_delta));
 	//freq_delta = ((fabs(freq_delta + _freq_max_dev) - fabs(freq_delta - _freq_max_dev)) / 2.0);
-	_freq = _center_freq + freq_delta;
+	tim->freq = tim->center_freq + freq_delta;
 }
 
 static float
@@ -95,12 +107,12 @@ mm_err(float prev, float cur)
 }
 
 static void
-update_alpha_beta(float damp, float bw)
+update_alpha_beta(Timing *tim, float damp, float bw)
 {
 	float denom;
 
 	denom = (1 + 2*damp*bw + bw*bw);
-	_alpha = 4*damp*bw/denom;
-	_beta = 4*bw*bw/denom;
+	tim->alpha = 4*damp*bw/denom;
+	tim->beta = 4*bw*bw/denom;
 }
 /* }}} */
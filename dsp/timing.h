@@ -2,33 +2,197 @@
 #define timing_h
 
 #include <complex.h>
+#include <math.h>
+#include <stddef.h>
+
+typedef struct {
+	float prev;
+	float complex prev_sym, mid, prev_mid;  /* Gardner detector history */
+	float phase, freq;                /* Symbol phase and rate estimate */
+	float freq_max_dev, center_freq;  /* Max freq deviation and center freq */
+	float alpha, beta;                /* Proportional and integral loop gain */
+	int state;                        /* Next timeslot type (dual mode only) */
+} Timing;
 
 /**
  * Initialize M&M symbol timing estimator
  *
+ * @param tim timing estimator object to initialize
  * @param sym_freq expected symbol frequency
  * @param bw bandwidth of the loop filter
  */
-void timing_init(float sym_freq, float bw);
+void timing_init(Timing *tim, float sym_freq, float bw);
 
 /**
  * Update symbol timing estimate
  *
+ * @param tim timing estimator object to update
+ * @param sample sample to update the estimate with
+ */
+void retime(Timing *tim, float complex sample);
+
+/**
+ * Update symbol timing estimate with the Gardner detector instead of M&M. The
+ * Gardner detector is decision-free and uses both the I and Q branches, but
+ * needs the sample halfway between two symbols, which must be passed to
+ * timing_midpoint() beforehand. The symbol clock must be advanced with
+ * skip_to_timeslot_dual() to know when that sample is due.
+ *
+ * retime_gardner() is for QPSK. It is insensitive to the carrier phase, so it
+ * can be fed samples that have not been through the PLL yet.
+ * retime_gardner_oqpsk() is for OQPSK. Its samples must be carrier-corrected,
+ * because the I and Q branches are offset by half a symbol.
+ *
+ * @param tim timing estimator object to update
  * @param sample sample to update the estimate with
  */
-void retime(float complex sample);
+void retime_gardner(Timing *tim, float complex sample);
+void retime_gardner_oqpsk(Timing *tim, float complex sample);
+
+/**
+ * Feed the Gardner detector the sample halfway between two symbols
+ *
+ * @param tim timing estimator object to update
+ * @param sample intersample
+ */
+static inline void
+timing_midpoint(Timing *tim, float complex sample)
+{
+	tim->prev_mid = tim->mid;
+	tim->mid = sample;
+}
 
 /**
  * Advance the internal symbol clock by one sample (not symbol, sample)
+ *
+ * @param tim timing estimator object to advance
+ * @return advance_timeslot(): 1 if a symbol is due, 0 otherwise.
+ *         advance_timeslot_dual(): 1 if an intersample is due, 2 if a symbol
+ *         is due, 0 otherwise. With less than one step per half symbol, both
+ *         can be due after the same step: timeslot_due_dual() checks for
+ *         another one without advancing the clock
  */
-int advance_timeslot();
-int advance_timeslot_dual();
+static inline int
+advance_timeslot(Timing *tim)
+{
+	tim->phase += tim->freq;
+
+	/* Check if the timeslot is right */
+	return tim->phase >= 2*(float)M_PI;
+}
+
+static inline int
+timeslot_due_dual(Timing *tim)
+{
+	int ret;
+
+	/* Check if the timeslot is right */
+	if (tim->phase >= tim->state * (float)M_PI) {
+		ret = tim->state;
+		tim->state = 3 - tim->state;    /* 1 <-> 2 */
+		return ret;
+	}
+
+	return 0;
+}
+
+static inline int
+advance_timeslot_dual(Timing *tim)
+{
+	/* Phase up */
+	tim->phase += tim->freq;
+
+	return timeslot_due_dual(tim);
+}
+
+/* Common part of skip_to_timeslot() and skip_to_timeslot_dual(), target
+ * being the phase at which the next timeslot is due */
+static inline size_t
+skip_to_timeslot_steps(Timing *tim, size_t max_steps, float target)
+{
+	const float remaining = (target - tim->phase) / tim->freq;
+	size_t steps;
+
+	/* If the timeslot is already due, report it on the next step, like
+	 * advance_timeslot_dual() would */
+	if (remaining > max_steps) {
+		steps = max_steps + 1;
+	} else {
+		steps = remaining > 1 ? (size_t)ceilf(remaining) : 1;
+	}
+
+	if (steps > max_steps) {
+		tim->phase += max_steps * tim->freq;
+		return 0;
+	}
+
+	tim->phase += steps * tim->freq;
+	return steps;
+}
+
+/**
+ * Advance the internal symbol clock straight to the next timeslot, instead of
+ * one step at a time, so that the demodulation loops only have to feed the
+ * filter with the samples in between
+ *
+ * @param tim timing estimator object to advance
+ * @param max_steps maximum number of steps to advance the clock by
+ * @param slot skip_to_timeslot_dual() only: set to 1 if the timeslot is an
+ *        intersample, 2 if it is a symbol
+ * @return number of steps taken to reach the timeslot, at least 1. 0 if it is
+ *         more than max_steps away, in which case the clock is advanced by
+ *         max_steps
+ */
+static inline size_t
+skip_to_timeslot(Timing *tim, size_t max_steps)
+{
+	return skip_to_timeslot_steps(tim, max_steps, 2*(float)M_PI);
+}
+
+static inline size_t
+skip_to_timeslot_dual(Timing *tim, size_t max_steps, int *slot)
+{
+	size_t steps;
+
+	if ((steps = skip_to_timeslot_steps(tim, max_steps, tim->state * (float)M_PI))) {
+		*slot = tim->state;
+		tim->state = 3 - tim->state;    /* 1 <-> 2 */
+	}
+
+	return steps;
+}
+
+/**
+ * Get how long ago the timeslot reported by advance_timeslot() or
+ * advance_timeslot_dual() actually fell, for interpolators with continuous
+ * timing resolution
+ *
+ * @param tim timing estimator object to query, before calling retime()
+ * @param slot 2 for advance_timeslot(), the value returned by
+ *        advance_timeslot_dual() otherwise
+ * @return time since the ideal sampling instant, as a fraction of a step
+ */
+static inline float
+timing_frac(const Timing *tim, int slot)
+{
+	return (tim->phase - slot*(float)M_PI) / tim->freq;
+}
 
 /**
  * Get the M&M symbol frequency estimate
  *
+ * @param tim timing estimator object to query
  * @return frequency
  */
-float mm_omega();
+float mm_omega(const Timing *tim);
+
+/**
+ * Set the symbol frequency estimate, e.g. to a value measured during a
+ * previous run. The value is clipped to the range allowed by timing_init()
+ *
+ * @param tim timing estimator object to modify
+ * @param freq new symbol frequency
+ */
+void timing_set_freq(Timing *tim, float freq);
 
 #endif
@@ -0,0 +1,94 @@
+#include <string.h>
+#include "encoder.h"
+#include "utils.h"
+
+#define HEADER_VERSION 1
+#define FLAG_OQPSK 0x01
+
+int
+encoder_parse_format(const char *name)
+{
+	if (!strcmp(name, "soft8")) return 8;
+	if (!strcmp(name, "soft4")) return 4;
+	if (!strcmp(name, "hard")) return 1;
+	return -1;
+}
+
+void
+encoder_init(Encoder *enc, Writer *out, int bits)
+{
+	enc->out = out;
+	enc->bits = bits;
+	enc->acc = 0;
+	enc->acc_bits = 0;
+	enc->bytes = 0;
+}
+
+void
+encoder_write_header(Encoder *enc, uint32_t symrate, int oqpsk)
+{
+	uint8_t header[ENCODER_HEADER_SIZE];
+
+	memset(header, 0, sizeof(header));
+	memcpy(header, "MSYM", 4);
+	header[4] = HEADER_VERSION;
+	header[5] = enc->bits;
+	header[6] = oqpsk ? FLAG_OQPSK : 0;
+	header[8] = symrate;
+	header[9] = symrate >> 8;
+	header[10] = symrate >> 16;
+	header[11] = symrate >> 24;
+
+	writer_write(enc->out, header, sizeof(header));
+	enc->bytes += sizeof(header);
+}
+
+void
+encoder_write(Encoder *enc, const int8_t *soft, size_t count)
+{
+	uint8_t packed[512];
+	size_t i, n;
+
+	if (enc->bits == 8) {
+		writer_write(enc->out, soft, count);
+		enc->bytes += count;
+		return;
+	}
+
+	for (i=0, n=0; i<count; i++) {
+		enc->acc <<= enc->bits;
+		enc->acc |= enc->bits == 4 ? (uint8_t)soft[i] >> 4 : (uint8_t)soft[i] >> 7;
+		enc->acc_bits += enc->bits;
+
+		if (enc->acc_bits == 8) {
+			packed[n++] = enc->acc;
+			enc->acc = 0;
+			enc->acc_bits = 0;
+
+			if (n == LEN(packed)) {
+				writer_write(enc->out, packed, n);
+				enc->bytes += n;
+				n = 0;
+			}
+		}
+	}
+
+	writer_write(enc->out, packed, n);
+	enc->bytes += n;
+}
+
+void
+encoder_flush(Encoder *enc)
+{
+	uint8_t last;
+
+	if (enc->acc_bits) {
+		last = enc->acc << (8 - enc->acc_bits);
+		writer_write(enc->out, &last, 1);
+		enc->bytes++;
+		enc->acc = 0;
+		enc->acc_bits = 0;
+	}
+
+	writer_flush(enc->out);
+}
@@ -0,0 +1,78 @@
+/**
+ * Soft symbol output encodings. Besides the plain 8-bit soft symbols, symbols
+ * can be packed into 4-bit soft nibbles or 1-bit hard decisions, prefixed by a
+ * header describing the encoding:
+ *
+ *   offset  size  content
+ *        0     4  "MSYM"
+ *        4     1  header version (1)
+ *        5     1  bits per I/Q component: 8, 4 or 1
+ *        6     1  flags: bit 0 set for OQPSK
+ *        7     1  reserved (0)
+ *        8     4  symbol rate, little-endian
+ *       12     4  reserved (0)
+ *
+ * Packed components are stored MSB first, I before Q. 4-bit components are
+ * two's complement (the 8-bit value shifted right by 4), 1-bit components are
+ * the sign bit of the 8-bit value (1 if negative)
+ */
+#ifndef encoder_h
+#define encoder_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "writer.h"
+
+#define ENCODER_HEADER_SIZE 16
+
+typedef struct {
+	Writer *out;
+	int bits;               /* Bits per I/Q component */
+	uint8_t acc;            /* Partially packed byte */
+	int acc_bits;           /* Number of bits in acc */
+	uint64_t bytes;         /* Bytes handed to the writer, header included */
+} Encoder;
+
+/**
+ * Parse an output format name
+ *
+ * @param name format name: soft8, soft4 or hard
+ * @return bits per I/Q component for the format, or -1 if the name is invalid
+ */
+int encoder_parse_format(const char *name);
+
+/**
+ * Initialize a symbol encoder
+ *
+ * @param enc encoder to initialize
+ * @param out writer to send the encoded symbols to
+ * @param bits bits per I/Q component, as returned by encoder_parse_format()
+ */
+void encoder_init(Encoder *enc, Writer *out, int bits);
+
+/**
+ * Write the format header. Must be called before any symbol is written
+ *
+ * @param enc encoder to write the header with
+ * @param symrate symbol rate of the stream
+ * @param oqpsk 1 if the symbols come from an OQPSK demodulator, 0 otherwise
+ */
+void encoder_write_header(Encoder *enc, uint32_t symrate, int oqpsk);
+
+/**
+ * Encode 8-bit soft I/Q components and send them to the writer
+ *
+ * @param enc encoder to use
+ * @param soft interleaved I/Q soft components
+ * @param count number of components (twice the number of symbols)
+ */
+void encoder_write(Encoder *enc, const int8_t *soft, size_t count);
+
+/**
+ * Pad the last partially packed byte with zeroes and flush the writer
+ *
+ * @param enc encoder to flush
+ */
+void encoder_flush(Encoder *enc);
+
+#endif
@@ -0,0 +1,67 @@
+#include "live.h"
+#include "utils.h"
+
+static double elapsed(const struct timespec *from, const struct timespec *to);
+
+int
+live_init(Live *live, pthread_t tid, double byte_rate, uint64_t offset)
+{
+	if (pthread_getcpuclockid(tid, &live->cpu_clock)) return 1;
+	if (clock_gettime(live->cpu_clock, &live->cpu)) return 1;
+	clock_gettime(CLOCK_MONOTONIC, &live->wall);
+
+	live->byte_rate = byte_rate;
+	live->offset = offset;
+	live->rtf = live->prev_rtf = 0;
+	live->backlog = live->prev_backlog = -1;
+	live->cpu_total = live->signal_total = 0;
+	live->max_rtf = live->max_backlog = 0;
+
+	return 0;
+}
+
+int
+live_update(Live *live, const Source *src, uint64_t offset)
+{
+	struct timespec wall, cpu;
+	double cpu_time, signal_time;
+	uint64_t backlog;
+
+	clock_gettime(CLOCK_MONOTONIC, &wall);
+	if (elapsed(&live->wall, &wall) < LIVE_INTERVAL) return 0;
+	if (clock_gettime(live->cpu_clock, &cpu)) return 0;
+
+	/* Only count the CPU time against the signal it was spent on */
+	cpu_time = elapsed(&live->cpu, &cpu);
+	signal_time = (offset - live->offset) / live->byte_rate;
+	live->prev_rtf = live->rtf;
+	live->rtf = signal_time > 0 ? cpu_time / signal_time : 0;
+	live->cpu_total += cpu_time;
+	live->signal_total += signal_time;
+
+	live->prev_backlog = live->backlog;
+	live->backlog = source_backlog(src, &backlog) ? -1 : backlog / live->byte_rate;
+
+	live->max_rtf = MAX(live->max_rtf, live->rtf);
+	live->max_backlog = MAX(live->max_backlog, live->backlog);
+	live->wall = wall;
+	live->cpu = cpu;
+	live->offset = offset;
+
+	return 1;
+}
+
+int
+live_behind(const Live *live, float max_backlog)
+{
+	if (live->rtf > 1 && live->prev_rtf > 1) return 1;
+	return live->backlog > max_backlog && live->backlog > live->prev_backlog;
+}
+
+/* Static functions {{{ */
+static double
+elapsed(const struct timespec *from, const struct timespec *to)
+{
+	return (to->tv_sec - from->tv_sec) + (to->tv_nsec - from->tv_nsec) * 1e-9;
+}
+/* }}} */
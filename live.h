@@ -0,0 +1,63 @@
+/**
+ * Real-time monitoring of a live input: how much CPU time the demodulator
+ * thread needs per second of signal, and how much input is waiting to be read
+ */
+#ifndef live_h
+#define live_h
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include "source.h"
+
+#define LIVE_INTERVAL 1.0           /* Seconds between two updates */
+
+typedef struct {
+	clockid_t cpu_clock;            /* CPU time clock of the demodulator thread */
+	double byte_rate;               /* Input bytes per second of signal */
+	struct timespec wall, cpu;      /* Clocks at the last update */
+	uint64_t offset;                /* Input position at the last update */
+
+	float rtf;                      /* Real-time factor: CPU time per second of signal */
+	float backlog;                  /* Seconds of signal waiting to be read, -1 if unknown */
+	float prev_rtf, prev_backlog;   /* At the previous update */
+
+	/* Over the whole run */
+	double cpu_total, signal_total;
+	float max_rtf, max_backlog;
+} Live;
+
+/**
+ * Start monitoring a demodulator thread
+ *
+ * @param live monitor to initialize
+ * @param tid thread running the demodulator
+ * @param byte_rate input bytes per second of signal
+ * @param offset current input position, as returned by source_tell()
+ * @return 0 on success, 1 if the CPU time of the thread can't be measured
+ */
+int live_init(Live *live, pthread_t tid, double byte_rate, uint64_t offset);
+
+/**
+ * Update the statistics, if LIVE_INTERVAL has gone by since the last update
+ *
+ * @param live monitor to update
+ * @param src source the demodulator reads from
+ * @param offset current input position, as returned by source_tell()
+ * @return 1 if the statistics were updated, 0 otherwise
+ */
+int live_update(Live *live, const Source *src, uint64_t offset);
+
+/**
+ * Check whether the demodulator is falling behind the input: the real-time
+ * factor has been over 1 for the last two updates, or the backlog is over
+ * max_backlog seconds and still growing. A pipe fills up long before the
+ * backlog gets large, so the former is what catches it there
+ *
+ * @param live monitor to query
+ * @param max_backlog backlog tolerated, in seconds
+ * @return 1 if falling behind, 0 otherwise
+ */
+int live_behind(const Live *live, float max_backlog);
+
+#endif
@@ -8,43 +8,120 @@
 #include <string.h>
 #include <time.h>
 #include "demod.h"
+#include "encoder.h"
 #include "dsp/timing.h"
+#include "live.h"
+#include "net.h"
+#include "parallel.h"
+#include "ring.h"
+#include "source.h"
+#include "telemetry.h"
 #include "utils.h"
 #include "wavfile.h"
+#include "writer.h"
 #ifdef ENABLE_TUI
 #include <ncurses.h>
 #include "tui.h"
 #endif
 
-#define SHORTOPTS "a:Bb:d:f:hm:o:O:qR:r:s:S:v"
+#define SHORTOPTS "a:Bb:D:d:f:hj:m:o:O:PqR:r:s:S:v"
 #define RINGSIZE 512
+#define BLOCKSIZE 4096
+#define PIPELINE_SLOTS 8
+#define PREPASS_LOCK_SECS 1.0   /* How long the PLL must stay locked during the pre-pass */
+#define TUI_SPEED_SECS 1.0      /* How often the TUI checks whether the demodulator keeps up */
+#define TUI_SPEED_MIN 0.95      /* Below this fraction of real time, the TUI backs off */
+#define LIVE_SHED_BACKLOG 1.0   /* Seconds of input waiting before shedding load */
+#define LIVE_MIN_ORDER 8        /* Lowest RRC filter order load shedding goes down to */
+
+/* Parameters used to create new demodulator instances */
+struct demod_opts {
+	float pll_bw;
+	int samplerate, symrate;
+	int interp_factor, rrc_order;
+	int oqpsk;
+	float freq_max;
+	int decim;
+	int acq;
+	int fixed;
+	int cubic;
+	int gardner;
+	int pre_agc;
+};
 
 struct thropts {
-	FILE *samples_file, *soft_file;
-	int bps;
-	int (*demod)(float complex *sample);
+	Demod *dem;
+	Source *src;
+	Encoder *enc;
+	size_t (*demod)(Demod *dem, float complex *dst, const float complex *src, size_t count);
+	size_t (*demod_s16)(Demod *dem, float complex *dst, const int16_t *src, size_t count);  /* Fixed-point mode only */
+	Ring *samples_ring, *symbols_ring;  /* Pipelined mode only */
+	struct demod_opts *opts;            /* Parallel mode only */
+	int jobs;
+	uint64_t progress;
 	int done;
+	int write_all;                      /* Write symbols even before the PLL locks */
+	int rrc_order;                      /* Filter order to switch to, lowered when shedding load */
+	unsigned ring_idx;
 	unsigned long bytes_out;
 	pthread_t main_tid;
 };
 
+/* Unit of work exchanged between pipeline stages. count == 0 signals EOF. In
+ * fixed-point mode, input blocks hold 2*BLOCKSIZE interleaved int16_t instead */
+struct block {
+	size_t count;
+	int locked_once;
+	uint64_t offset;            /* Input position after this block */
+	float complex data[BLOCKSIZE];
+};
+
 static void* thread_process(void *parms);
+static void* thread_input(void *parms);
+static void* thread_demod(void *parms);
+static void* thread_output(void *parms);
+static void* thread_parallel(void *parms);
+static Demod* create_demod(void *opts);
+static int prepass(volatile struct thropts *parms, FILE *fd, int bps, uint64_t start, uint64_t end, DemodState *state, uint64_t *lock_pos);
+static void write_symbols(volatile struct thropts *parms, const float complex *symbols, size_t count, int locked_once);
+static void flush_symbols(volatile struct thropts *parms);
+static void update_telemetry(const Demod *dem, const Source *src, const float complex *symbols, size_t count, uint64_t offset);
+static void publish_telemetry(const Demod *dem, const Source *src, uint64_t offset);
+static int shed_load(volatile struct thropts *parms, const Live *live);
 static void noop(int x) { return; }
 
 static int8_t _symbols_ring[2*RINGSIZE];
+static Telemetry _telemetry;
 static struct option longopts[] = {
 	{ "batch",        0, NULL, 'B' },
 	{ "pll-bw",       1, NULL, 'b' },
+	{ "decim",        1, NULL, 'D' },
 	{ "freq-delta",   1, NULL, 'd' },
 	{ "fir-order",    1, NULL, 'f' },
 	{ "help",         0, NULL, 'h' },
+	{ "jobs",         1, NULL, 'j' },
 	{ "mode",         1, NULL, 'm' },
 	{ "output",       1, NULL, 'o' },
 	{ "oversamp",     1, NULL, 'O' },
+	{ "pipeline",     0, NULL, 'P' },
 	{ "quiet",        0, NULL, 'q' },
 	{ "refresh-rate", 1, NULL, 'R' },
 	{ "symrate",      1, NULL, 'r' },
 	{ "stdout",       0, NULL, 0x00},
+	{ "no-acq",       0, NULL, 0x01},
+	{ "fixed",        0, NULL, 0x02},
+	{ "tune",         1, NULL, 0x03},
+	{ "jitter",       1, NULL, 0x04},
+	{ "out-buffers",  1, NULL, 0x05},
+	{ "out-bufsize",  1, NULL, 0x06},
+	{ "format",       1, NULL, 0x07},
+	{ "header",       0, NULL, 0x08},
+	{ "two-pass",     0, NULL, 0x09},
+	{ "cubic",        0, NULL, 0x0a},
+	{ "ted",          1, NULL, 0x0b},
+	{ "pre-agc",      0, NULL, 0x0c},
+	{ "live",         0, NULL, 0x0d},
+	{ "shed",         0, NULL, 0x0e},
 	{ "samplerate",   1, NULL, 's' },
 	{ "bps",          1, NULL, 'S' },
 	{ "version",      0, NULL, 'v' },
@@ -54,13 +131,35 @@ static struct option longopts[] = {
 int
 main(int argc, char *argv[])
 {
-	unsigned long file_len, tmp;
+	unsigned long file_len, data_start;
 	FILE *samples_file, *soft_file;
 	int c, i, j=0;
 	volatile struct thropts thread_args;
-	pthread_t tid;
+	struct demod_opts demod_opts;
+	Demod *dem;
+	Source *src;
+	NetSource *net;
+	Writer writer;
+	Encoder enc;
+	WriterStats wstats;
+	Ring samples_ring, symbols_ring;
+	pthread_t tids[3];
+	int nthreads;
 	struct timespec sleep_timespec;
 	float freq_hz, rate_hz;
+	uint64_t net_errors, lock_pos;
+	DemodState prepass_state;
+	const TelemetryData *tm;
+	Live live_stats;
+	int shed_order;
+#ifdef ENABLE_TUI
+	struct timespec speed_ts, now_ts;
+	uint64_t speed_offset;
+	double elapsed;
+#endif
+#ifdef ENABLE_PROFILING
+	char prof_buf[128];
+#endif
 
 	/* Command-line changeable parameters {{{ */
 	float pll_bw = PLL_BW;
@@ -69,13 +168,30 @@ main(int argc, char *argv[])
 	int quiet = 0;
 	float symrate = SYM_RATE;
 	float freq_max_delta = -1;
-	int (*demod)(float complex *sample) = demod_qpsk;
+	size_t (*demod)(Demod *dem, float complex *dst, const float complex *src, size_t count) = demod_qpsk_block;
 	int (*message)(const char *fmt, ...) = printf;
 	int batch = 0;
 	int update_interval = -1;
 	int bps = 0;
 	int samplerate = -1;
 	int stdout_mode = 0;
+	int pipeline = 0;
+	int decim = -1;
+	int acq = 1;
+	int fixed = 0;
+	uint32_t tune_freq = 0;
+	unsigned jitter = NET_JITTER_DEPTH;
+	unsigned out_bufs = WRITER_NBUFS;
+	size_t out_bufsize = WRITER_BUFSIZE;
+	int out_bits = 8;
+	int header = 0;
+	int two_pass = 0;
+	int cubic = 0;
+	int gardner = 0;
+	int pre_agc = 0;
+	int live = 0;
+	int shed = 0;
+	int jobs = 1;
 	char *output_fname = NULL;
 	/* }}} */
 	/* Parse command-line options {{{ */
@@ -85,12 +201,82 @@ main(int argc, char *argv[])
 				/* Stdout mode */
 				stdout_mode = 1;
 				break;
+			case 0x01:
+				/* Disable FFT carrier acquisition */
+				acq = 0;
+				break;
+			case 0x02:
+				/* Fixed-point signal path */
+				fixed = 1;
+				break;
+			case 0x03:
+				/* rtl_tcp center frequency */
+				tune_freq = human_to_float(optarg);
+				break;
+			case 0x04:
+				/* UDP jitter buffer size */
+				jitter = MAX(1, atoi(optarg));
+				break;
+			case 0x05:
+				/* Number of output buffers */
+				out_bufs = MAX(2, atoi(optarg));
+				break;
+			case 0x06:
+				/* Size of each output buffer */
+				out_bufsize = MAX(1, human_to_float(optarg));
+				break;
+			case 0x07:
+				/* Output symbol encoding */
+				if ((out_bits = encoder_parse_format(optarg)) < 0) {
+					fprintf(stderr, "Invalid output format: %s\n", optarg);
+					usage(argv[0]);
+					return 1;
+				}
+				break;
+			case 0x08:
+				/* Prefix 8-bit output with a format header */
+				header = 1;
+				break;
+			case 0x09:
+				/* Estimate the loop parameters before demodulating */
+				two_pass = 1;
+				break;
+			case 0x0a:
+				/* Cubic timing interpolator */
+				cubic = 1;
+				break;
+			case 0x0b:
+				/* Timing error detector */
+				if (!strcmp(optarg, "gardner")) {
+					gardner = 1;
+				} else if (strcmp(optarg, "mm")) {
+					fprintf(stderr, "Invalid timing error detector: %s\n", optarg);
+					usage(argv[0]);
+					return 1;
+				}
+				break;
+			case 0x0c:
+				/* Input rate AGC */
+				pre_agc = 1;
+				break;
+			case 0x0d:
+				/* Compare the demodulator speed to real time */
+				live = 1;
+				break;
+			case 0x0e:
+				/* Lower the filter order when falling behind */
+				live = 1;
+				shed = 1;
+				break;
 			case 'b':
 				pll_bw = human_to_float(optarg);
 				break;
 			case 'B':
 				batch = 1;
 				break;
+			case 'D':
+				decim = atoi(optarg);
+				break;
 			case 'd':
 				freq_max_delta = human_to_float(optarg);
 				break;
@@ -100,8 +286,11 @@ main(int argc, char *argv[])
 			case 'h':
 				usage(argv[0]);
 				return 0;
+			case 'j':
+				jobs = MAX(1, atoi(optarg));
+				break;
 			case 'm':
-				if (!strcmp(optarg, "oqpsk")) demod = demod_oqpsk;
+				if (!strcmp(optarg, "oqpsk")) demod = demod_oqpsk_block;
 				break;
 			case 'o':
 				output_fname = optarg;
@@ -109,6 +298,9 @@ main(int argc, char *argv[])
 			case 'O':
 				interp_factor = atoi(optarg);
 				break;
+			case 'P':
+				pipeline = 1;
+				break;
 			case 'q':
 				quiet = 1;
 				break;
@@ -146,22 +338,27 @@ main(int argc, char *argv[])
 		batch = 1;
 		quiet = 1;
 	}
-#ifdef ENABLE_TUI
-	message = batch ? printf : tui_print_info;
-#endif
 	/* }}} */
 
 	/* Open input file */
-	if (!strcmp(argv[optind], "-")) {
+	if (net_is_url(argv[optind])) {
+		/* Opened later, once the sample rate and format are known */
+		samples_file = NULL;
+		if (!strncmp(argv[optind], "rtl_tcp://", strlen("rtl_tcp://"))) bps = 8;
+	} else if (!strcmp(argv[optind], "-")) {
 		samples_file = stdin;
 		batch = 1;          /* Ncurses doesn't play nice with stdin samples */
 	} else if (!(samples_file = fopen(argv[optind], "rb"))) {
 		fprintf(stderr, "Could not open input file\n");
 		return 1;
 	}
+	if (jobs > 1) batch = 1;    /* No single set of loop parameters to display */
+#ifdef ENABLE_TUI
+	message = batch ? printf : tui_print_info;
+#endif
 
 	/* Parse wav header. If it fails, assume raw data */
-	if (wav_parse(samples_file, &samplerate, &bps)) {
+	if (samples_file && wav_parse(samples_file, &samplerate, &bps)) {
 		fseek(samples_file, 0, SEEK_SET);
 	}
 
@@ -174,6 +371,23 @@ main(int argc, char *argv[])
 		fprintf(stderr, "Could not auto-detect bits per sample, assuming 16\n");
 		bps = 16;
 	}
+	if (fixed && bps != 8 && bps != 16) {
+		fprintf(stderr, "Fixed-point mode requires 8 or 16 bits per sample, using floating point\n");
+		fixed = 0;
+	}
+	if (fixed && jobs > 1) {
+		fprintf(stderr, "Fixed-point mode is not supported with multiple jobs, using floating point\n");
+		fixed = 0;
+	}
+	if (cubic && fixed) {
+		fprintf(stderr, "Cubic interpolation is not supported in fixed-point mode, using the polyphase filter\n");
+		cubic = 0;
+	}
+	if (cubic) interp_factor = 1;   /* The interpolator replaces the filter bank */
+	if (gardner && (fixed || cubic)) {
+		fprintf(stderr, "The Gardner detector requires the floating point polyphase filter, using M&M\n");
+		gardner = 0;
+	}
 
 	/* Open output file */
 	if (stdout_mode) {
@@ -182,45 +396,165 @@ main(int argc, char *argv[])
 		fprintf(stderr, "Could not open output file\n");
 		return 1;
 	}
+	if (writer_init(&writer, fileno(soft_file), out_bufs, out_bufsize)) {
+		fprintf(stderr, "Could not allocate output buffers\n");
+		return 1;
+	}
+
+	/* Packed formats can't be told apart from each other without a header,
+	 * plain 8-bit symbols stay headerless unless requested for compatibility
+	 * with existing decoders */
+	encoder_init(&enc, &writer, out_bits);
+	if (header || out_bits != 8) encoder_write_header(&enc, symrate, demod == demod_oqpsk_block);
 
 	/* Initialize subsystems */
-	demod_init(pll_bw, SYM_BW, samplerate, symrate, interp_factor, rrc_order, demod == demod_oqpsk, freq_max_delta);
+	demod_opts.pll_bw = pll_bw;
+	demod_opts.samplerate = samplerate;
+	demod_opts.symrate = symrate;
+	demod_opts.interp_factor = interp_factor;
+	demod_opts.rrc_order = rrc_order;
+	demod_opts.oqpsk = demod == demod_oqpsk_block;
+	demod_opts.freq_max = freq_max_delta;
+	demod_opts.decim = decim;
+	demod_opts.acq = acq;
+	demod_opts.fixed = fixed;
+	demod_opts.cubic = cubic;
+	demod_opts.gardner = gardner;
+	demod_opts.pre_agc = pre_agc;
+	if (!(dem = create_demod(&demod_opts))) {
+		fprintf(stderr, "Could not initialize demodulator\n");
+		return 1;
+	}
 
-	/* Get file length */
-	tmp = ftell(samples_file);
-	fseek(samples_file, 0, SEEK_END);
-	file_len = MAX(0, ftell(samples_file));
-	fseek(samples_file, tmp, SEEK_SET);
+	if (samples_file) {
+		/* Get file length */
+		data_start = ftell(samples_file);
+		fseek(samples_file, 0, SEEK_END);
+		file_len = MAX(0, ftell(samples_file));
+		fseek(samples_file, data_start, SEEK_SET);
+
+		/* Memory-map the input if possible, use buffered reads otherwise */
+		src = source_open(samples_file, bps);
+	} else {
+		file_len = data_start = 0;
+		if (!(net = net_open(argv[optind], samplerate, tune_freq, bps, jitter))) {
+			fprintf(stderr, "Could not open network source %s\n", argv[optind]);
+			return 1;
+		}
+		src = source_open_net(net, bps);
+	}
+	if (!src) {
+		fprintf(stderr, "Unsupported bits per sample value: %d\n", bps);
+		return 1;
+	}
+	if (jobs > 1 && !src->map) {
+		fprintf(stderr, "Parallel demodulation requires a seekable input file, using a single thread\n");
+		jobs = 1;
+	}
+	if (two_pass && (jobs > 1 || !src->map)) {
+		fprintf(stderr, "Two-pass mode requires a seekable input file and a single job, disabling\n");
+		two_pass = 0;
+	}
+	if (live && jobs > 1) {
+		fprintf(stderr, "Live mode is not supported with multiple jobs, disabling\n");
+		live = shed = 0;
+	}
 
 
 #ifdef ENABLE_TUI
-	if (!batch) tui_init(update_interval);
+	if (!batch) tui_init(update_interval, live);
 #endif
 
 	if (!quiet) message("Input: %s, output: %s\n", argv[optind], output_fname);
 
 	/* Prepare thread arguments */
-	thread_args.samples_file = samples_file;
-	thread_args.soft_file = soft_file;
-	thread_args.bps = bps;
+	thread_args.dem = dem;
+	thread_args.src = src;
+	thread_args.enc = &enc;
 	thread_args.demod = demod;
+	thread_args.demod_s16 = !fixed ? NULL : demod == demod_oqpsk_block ? demod_oqpsk_block_s16 : demod_qpsk_block_s16;
+	thread_args.opts = &demod_opts;
+	thread_args.jobs = jobs;
+	thread_args.progress = 0;
 	thread_args.done = 0;
+	thread_args.write_all = 0;
+	thread_args.rrc_order = rrc_order;
+	thread_args.ring_idx = 0;
+	thread_args.bytes_out = enc.bytes;
 	thread_args.main_tid = pthread_self();
+	telemetry_init(&_telemetry);
 
 	sleep_timespec.tv_sec = update_interval / 1000;
 	sleep_timespec.tv_nsec = (update_interval % 1000) * 1000L * 1000;
+	net_errors = 0;
+
+	if (two_pass) {
+		/* Find out where the carrier and symbol clock are once the signal
+		 * shows up, then demodulate from the start with the loops already
+		 * converged, keeping the symbols received before the first lock */
+		if (!quiet) message("Pre-pass: looking for the signal...\n");
+		if (!prepass(&thread_args, samples_file, bps, data_start, file_len, &prepass_state, &lock_pos)) {
+			demod_seed(dem, &prepass_state);
+			thread_args.write_all = 1;
+			if (!quiet) {
+				message("Pre-pass: locked at %.1fs, carrier: %+.1f Hz, symbol rate: %.1f Hz\n",
+				        (double)lock_pos / samplerate,
+				        prepass_state.carrier_freq*symrate/(2*M_PI)*(demod == demod_oqpsk_block ? 2 : 1),
+				        prepass_state.symbol_freq*(dem->samplerate*interp_factor)/(2*M_PI));
+			}
+		} else if (!quiet) {
+			message("Pre-pass: the PLL never locked, demodulating normally\n");
+		}
+	}
+
+	/* Let the status display start off with the initial estimates */
+	publish_telemetry(dem, src, source_tell(src));
 
 	/* SIGUSR1 is used just to wake up the main thread when the demod thread
 	 * exits, so connect it to a no-op handler */
 	signal(SIGUSR1, &noop);
 
-	/* Launch demod thread */
-	pthread_create(&tid, NULL, thread_process, (void*)&thread_args);
-	if (!quiet) message("Demodulator initialized\n");
+	if (jobs > 1) {
+		/* Launch parallel chunked demodulation */
+		pthread_create(&tids[0], NULL, thread_parallel, (void*)&thread_args);
+		nthreads = 1;
+		pipeline = 0;
+	} else if (pipeline) {
+		/* Launch input, demod and output threads, connected by SPSC rings */
+		if (ring_init(&samples_ring, PIPELINE_SLOTS, sizeof(struct block), &thread_args.done)
+		 || ring_init(&symbols_ring, PIPELINE_SLOTS, sizeof(struct block), &thread_args.done)) {
+			fprintf(stderr, "Could not allocate pipeline buffers\n");
+			return 1;
+		}
+		thread_args.samples_ring = &samples_ring;
+		thread_args.symbols_ring = &symbols_ring;
+
+		pthread_create(&tids[0], NULL, thread_input, (void*)&thread_args);
+		pthread_create(&tids[1], NULL, thread_demod, (void*)&thread_args);
+		pthread_create(&tids[2], NULL, thread_output, (void*)&thread_args);
+		nthreads = 3;
+	} else {
+		/* Launch demod thread */
+		pthread_create(&tids[0], NULL, thread_process, (void*)&thread_args);
+		nthreads = 1;
+	}
+	if (live && live_init(&live_stats, tids[pipeline ? 1 : 0], 2.0*samplerate*bps/8, source_tell(src))) {
+		fprintf(stderr, "Could not measure the demodulator CPU time, disabling live mode\n");
+		live = shed = 0;
+	}
+	if (!quiet) {
+		if (dem->decim.count || dem->qdecim.count) {
+			message("Decimating by %d (%.0f samples/s)\n", 1 << (dem->decim.count + dem->qdecim.count), dem->samplerate);
+		}
+		if (fixed) message("Using fixed-point signal path\n");
+		message("Demodulator initialized\n");
+	}
 
 #ifdef ENABLE_TUI
 	if (!batch) {
 		/* TUI mode: update ncurses screen until done */
+		clock_gettime(CLOCK_MONOTONIC, &speed_ts);
+		speed_offset = telemetry_read(&_telemetry)->offset;
 		while (!thread_args.done) {
 			/* Exit on user request. Also throttles refresh rate */
 			if (tui_process_input()) {
@@ -228,14 +562,41 @@ main(int argc, char *argv[])
 				break;
 			}
 
-			freq_hz = pll_get_freq()*symrate/(2*M_PI)*(demod == demod_oqpsk ? 2 : 1);
-			rate_hz = mm_omega()*(samplerate*interp_factor)/(2*M_PI);
+			tm = telemetry_read(&_telemetry);
+			freq_hz = tm->carrier_freq*symrate/(2*M_PI)*(demod == demod_oqpsk_block ? 2 : 1);
+			rate_hz = tm->symbol_freq*(dem->samplerate*interp_factor)/(2*M_PI);
 
 			/* Update TUI */
-			tui_update_file_in(2*samplerate*bps/8, ftell(samples_file), file_len);
-			tui_update_data_out(thread_args.bytes_out);
-			tui_update_pll(freq_hz, rate_hz, pll_get_locked(), agc_get_gain());
-			tui_draw_constellation(_symbols_ring, LEN(_symbols_ring));
+			tui_update_file_in(2*samplerate*bps/8, tm->offset, file_len);
+			tui_update_data_out(__atomic_load_n(&thread_args.bytes_out, __ATOMIC_RELAXED));
+			tui_update_pll(freq_hz, rate_hz, tm->locked, tm->gain);
+			tui_draw_constellation(tm->symbols, LEN(tm->symbols));
+			if (live && live_update(&live_stats, src, tm->offset)) {
+				tui_update_live(live_stats.rtf, live_stats.backlog);
+				if (shed && (shed_order = shed_load(&thread_args, &live_stats))) {
+					message("Falling behind the input, lowering the filter order to %d\n", shed_order);
+				}
+			}
+
+			/* Redraw less often while the input is consumed slower than it
+			 * is produced, leaving the CPU to the demodulator */
+			clock_gettime(CLOCK_MONOTONIC, &now_ts);
+			elapsed = (now_ts.tv_sec - speed_ts.tv_sec) + (now_ts.tv_nsec - speed_ts.tv_nsec) * 1e-9;
+			if (elapsed >= TUI_SPEED_SECS) {
+				tui_set_behind((tm->offset - speed_offset) / (2.0*samplerate*bps/8) < TUI_SPEED_MIN * elapsed);
+				speed_ts = now_ts;
+				speed_offset = tm->offset;
+			}
+			if (tm->net.dropped + tm->net.late != net_errors) {
+				net_errors = tm->net.dropped + tm->net.late;
+				message("Network: %llu dropped, %llu late packets\n",
+				        (unsigned long long)tm->net.dropped,
+				        (unsigned long long)tm->net.late);
+			}
+#ifdef ENABLE_PROFILING
+			prof_format(&tm->prof, prof_buf, sizeof(prof_buf));
+			tui_update_profile(prof_buf);
+#endif
 		}
 
 		message("Demodulation complete\n");
@@ -244,35 +605,110 @@ main(int argc, char *argv[])
 		tui_deinit();
 	} else {
 #endif
-	if (!quiet) {
-		/* Batch mode: periodically write status line */
+	if (!quiet || live) {
+		/* Batch mode: periodically write status line. Live mode keeps
+		 * monitoring even when quiet, only without the status line */
 		while (!thread_args.done) {
-			freq_hz = pll_get_freq()*symrate/(2*M_PI)*(demod == demod_oqpsk ? 2 : 1);
-			rate_hz = mm_omega()*(samplerate*interp_factor)/(2*M_PI);
+			if (jobs > 1) {
+				message("\n(%5.1f%%) Demodulating %d chunks in parallel",
+				        file_len ? 100.0 * __atomic_load_n(&thread_args.progress, __ATOMIC_RELAXED)/file_len : 0,
+				        jobs);
+				fflush(stdout);
+				nanosleep(&sleep_timespec, NULL);
+				continue;
+			}
+
+			tm = telemetry_read(&_telemetry);
+			if (live && live_update(&live_stats, src, tm->offset)
+			 && shed && (shed_order = shed_load(&thread_args, &live_stats))) {
+				/* Same layout as the status line when it's printed */
+				fprintf(stderr, quiet ? "Falling behind the input, lowering the filter order to %d\n"
+				                      : "\nFalling behind the input, lowering the filter order to %d",
+				        shed_order);
+			}
+			if (quiet) {
+				nanosleep(&sleep_timespec, NULL);
+				continue;
+			}
+
+			freq_hz = tm->carrier_freq*symrate/(2*M_PI)*(demod == demod_oqpsk_block ? 2 : 1);
+			rate_hz = tm->symbol_freq*(dem->samplerate*interp_factor)/(2*M_PI);
 
 			message(batch ? "\n" : "\033[1K\r");
 			message("(%5.1f%%) Carrier: %+7.1f Hz, Symbol rate: %.1f Hz, Locked: %s",
-				   file_len ? 100.0 * ftell(samples_file)/file_len : 0,
+				   file_len ? 100.0 * tm->offset/file_len : 0,
 				   freq_hz,
 				   rate_hz,
-				   pll_get_locked() ? "Yes" : "No");
+				   tm->locked ? "Yes" : "No");
+			if (src->net && src->net->udp) {
+				message(", Dropped: %llu, Late: %llu",
+				        (unsigned long long)tm->net.dropped,
+				        (unsigned long long)tm->net.late);
+			}
+			if (live) {
+				message(", Real-time factor: %.2f", live_stats.rtf);
+				if (live_stats.backlog >= 0) message(", Backlog: %.1fs", live_stats.backlog);
+			}
+			writer_get_stats(&writer, &wstats);
+			if (wstats.stalls) message(", Output stalled: %.1fs", wstats.stall_time);
+#ifdef ENABLE_PROFILING
+			prof_format(&tm->prof, prof_buf, sizeof(prof_buf));
+			message(", Profile: %s", prof_buf);
+#endif
 			fflush(stdout);
 			nanosleep(&sleep_timespec, NULL);
 		}
-		printf("\n");
+		if (!quiet) printf("\n");
 	}
 
 #ifdef ENABLE_TUI
 	}       /* if (!batch) else */
 #endif
 
-	/* Join demod thread */
-	pthread_join(tid, NULL);
+	/* Join demod thread(s) */
+	for (i=0; i<nthreads; i++) {
+		pthread_join(tids[i], NULL);
+	}
+	if (pipeline) {
+		ring_deinit(&samples_ring);
+		ring_deinit(&symbols_ring);
+	}
+
+#ifdef ENABLE_PROFILING
+	prof_summary(&dem->prof, stderr);
+#endif
+	if (src->net && src->net->udp) {
+		fprintf(stderr, "Network: %llu packets received, %llu dropped, %llu late, %llu resyncs\n",
+		        (unsigned long long)src->net->stats.packets,
+		        (unsigned long long)src->net->stats.dropped,
+		        (unsigned long long)src->net->stats.late,
+		        (unsigned long long)src->net->stats.resyncs);
+	}
+
+	/* Write out whatever is still buffered */
+	if (writer_deinit(&writer)) fprintf(stderr, "Error writing to %s\n", output_fname);
+	if (!quiet) {
+		fflush(stdout);
+		wstats = writer.stats;
+		fprintf(stderr, "Output: %llu bytes, writer blocked for %.2fs, demodulator stalled %llu times (%.2fs, %u/%u buffers in use at most)\n",
+		        (unsigned long long)wstats.bytes, wstats.write_time,
+		        (unsigned long long)wstats.stalls, wstats.stall_time,
+		        wstats.max_queued, out_bufs);
+	}
+	if (live) {
+		fprintf(stderr, "Live: real-time factor %.2f on average, %.2f at most",
+		        live_stats.signal_total > 0 ? live_stats.cpu_total / live_stats.signal_total : 0,
+		        live_stats.max_rtf);
+		if (live_stats.backlog >= 0) fprintf(stderr, ", backlog %.1fs at most", live_stats.max_backlog);
+		if (thread_args.rrc_order != rrc_order) fprintf(stderr, ", filter order lowered to %d", thread_args.rrc_order);
+		fprintf(stderr, "\n");
+	}
 
 	/* Cleanup */
-	demod_deinit();
+	demod_deinit(dem);
+	source_close(src);
 	if (soft_file != stdout) fclose(soft_file);
-	if (samples_file != stdin) fclose(samples_file);
+	if (samples_file && samples_file != stdin) fclose(samples_file);
 
 	return 0;
 }
@@ -284,42 +720,176 @@ main(int argc, char *argv[])
 static void*
 thread_process(void *x)
 {
-	float complex sample;
-	FILE *samples_file, *soft_file;
-	int bps;
-	int (*demod)(float complex *sample);
-	unsigned ring_idx;
+	float complex buf[BLOCKSIZE], symbols[BLOCKSIZE];
+	int16_t raw_buf[2*BLOCKSIZE];
+	const float complex *samples;
+	const int16_t *raw;
+	Demod *dem;
+	Source *src;
+	size_t (*demod)(Demod *dem, float complex *dst, const float complex *src, size_t count);
+	size_t (*demod_s16)(Demod *dem, float complex *dst, const int16_t *src, size_t count);
+	size_t count, nsyms;
+	int rrc_order, order;
 	volatile struct thropts *parms = (struct thropts *)x;
 
-	samples_file = parms->samples_file;
-	soft_file = parms->soft_file;
-	bps = parms->bps;
+	dem = parms->dem;
+	src = parms->src;
 	demod = parms->demod;
-	ring_idx = 0;
-
+	demod_s16 = parms->demod_s16;
+	rrc_order = parms->rrc_order;
 
 	/* Main processing loop */
-	parms->bytes_out = 0;
-	while (!parms->done && wav_read(&sample, bps, samples_file)) {
-		if (demod(&sample)) {
-			_symbols_ring[ring_idx++] = MAX(-127, MIN(127, crealf(sample)/2));
-			_symbols_ring[ring_idx++] = MAX(-127, MIN(127, cimagf(sample)/2));
-
-			if (ring_idx >= LEN(_symbols_ring)) {
-				ring_idx = 0;
-
-				/* Only write symbols after the PLL locked once */
-				if (pll_did_lock_once()) {
-					fwrite(_symbols_ring, RINGSIZE, 2, soft_file);
-					parms->bytes_out += LEN(_symbols_ring);
-				}
-			}
+	while (!parms->done) {
+		/* Switch filters between blocks when shedding load. If the new one
+		 * can't be allocated, keep going with the old one */
+		if ((order = __atomic_load_n(&parms->rrc_order, __ATOMIC_RELAXED)) != rrc_order) {
+			rrc_order = order;
+			demod_set_rrc_order(dem, rrc_order);
 		}
+
+		/* Read a block of samples */
+		count = BLOCKSIZE;
+		if (demod_s16) {
+			PROFILE(&dem->prof, PROF_READ, raw = source_read_s16(src, raw_buf, &count));
+			if (!count) break;
+			nsyms = demod_s16(dem, symbols, raw, count);
+		} else {
+			PROFILE(&dem->prof, PROF_READ, samples = source_read(src, buf, &count));
+			if (!count) break;
+			nsyms = demod(dem, symbols, samples, count);
+		}
+
+		update_telemetry(dem, src, symbols, nsyms, source_tell(src));
+		PROFILE(&dem->prof, PROF_WRITE, write_symbols(parms, symbols, nsyms, pll_did_lock_once(&dem->pll)));
 	}
 
-	/* Flush output buffer */
-	fwrite(_symbols_ring, ring_idx, 2, soft_file);
-	parms->bytes_out += ring_idx;
+	flush_symbols(parms);
+	return NULL;
+}
+
+/**
+ * Pipeline stage 1: read samples and convert them to float complex
+ */
+static void*
+thread_input(void *x)
+{
+	const float complex *samples;
+	const int16_t *raw;
+	struct block *blk;
+	volatile struct thropts *parms = (struct thropts *)x;
+
+	do {
+		if (!(blk = ring_acquire_write(parms->samples_ring))) break;
+
+		blk->count = BLOCKSIZE;
+		if (parms->demod_s16) {
+			PROFILE(&parms->dem->prof, PROF_READ, raw = source_read_s16(parms->src, (int16_t*)blk->data, &blk->count));
+			if (raw != (int16_t*)blk->data) memcpy(blk->data, raw, 2 * blk->count * sizeof(*raw));
+		} else {
+			PROFILE(&parms->dem->prof, PROF_READ, samples = source_read(parms->src, blk->data, &blk->count));
+			if (samples != blk->data) memcpy(blk->data, samples, blk->count * sizeof(*samples));
+		}
+		blk->offset = source_tell(parms->src);
+
+		ring_commit_write(parms->samples_ring);
+	} while (blk->count);
+
+	return NULL;
+}
+
+/**
+ * Pipeline stage 2: filter, AGC, carrier and symbol timing recovery
+ */
+static void*
+thread_demod(void *x)
+{
+	Demod *dem;
+	struct block *in, *out;
+	size_t (*demod)(Demod *dem, float complex *dst, const float complex *src, size_t count);
+	size_t (*demod_s16)(Demod *dem, float complex *dst, const int16_t *src, size_t count);
+	size_t count;
+	int rrc_order, order;
+	volatile struct thropts *parms = (struct thropts *)x;
+
+	dem = parms->dem;
+	demod = parms->demod;
+	demod_s16 = parms->demod_s16;
+	rrc_order = parms->rrc_order;
+
+	do {
+		if (!(in = ring_acquire_read(parms->samples_ring))) break;
+		if (!(out = ring_acquire_write(parms->symbols_ring))) break;
+
+		/* Same as in thread_process() */
+		if ((order = __atomic_load_n(&parms->rrc_order, __ATOMIC_RELAXED)) != rrc_order) {
+			rrc_order = order;
+			demod_set_rrc_order(dem, rrc_order);
+		}
+
+		count = in->count;
+		if (!count) {
+			out->count = 0;
+		} else if (demod_s16) {
+			out->count = demod_s16(dem, out->data, (const int16_t*)in->data, count);
+		} else {
+			out->count = demod(dem, out->data, in->data, count);
+		}
+		out->locked_once = pll_did_lock_once(&dem->pll);
+		update_telemetry(dem, parms->src, out->data, out->count, in->offset);
+
+		/* Make sure EOF is forwarded even if no symbols were produced */
+		if (count && !out->count) {
+			ring_commit_read(parms->samples_ring);
+			continue;
+		}
+
+		ring_commit_write(parms->symbols_ring);
+		ring_commit_read(parms->samples_ring);
+	} while (count);
+
+	return NULL;
+}
+
+/**
+ * Pipeline stage 3: pack symbols and write them to the output file
+ */
+static void*
+thread_output(void *x)
+{
+	struct block *blk;
+	size_t count;
+	volatile struct thropts *parms = (struct thropts *)x;
+
+	do {
+		if (!(blk = ring_acquire_read(parms->symbols_ring))) break;
+
+		count = blk->count;
+		PROFILE(&parms->dem->prof, PROF_WRITE, write_symbols(parms, blk->data, count, blk->locked_once));
+
+		ring_commit_read(parms->symbols_ring);
+	} while (count);
+
+	flush_symbols(parms);
+	return NULL;
+}
+
+/**
+ * Parallel mode: split the file into chunks and demodulate them concurrently
+ */
+static void*
+thread_parallel(void *x)
+{
+	volatile struct thropts *parms = (struct thropts *)x;
+	long written;
+
+	written = parallel_demod(parms->src->fd, parms->src->bps,
+	                         parms->opts->samplerate, parms->opts->symrate, parms->jobs,
+	                         parms->demod, create_demod, parms->opts,
+	                         parms->enc, &parms->progress);
+
+	if (written < 0) fprintf(stderr, "Parallel demodulation failed\n");
+	encoder_flush(parms->enc);
+	__atomic_store_n(&parms->bytes_out, parms->enc->bytes, __ATOMIC_RELAXED);
 	parms->done = 1;
 
 	/* Wake up main thread */
@@ -327,4 +897,178 @@ thread_process(void *x)
 
 	return NULL;
 }
+
+/**
+ * Create a new demodulator instance based on the command-line parameters
+ */
+static Demod*
+create_demod(void *x)
+{
+	const struct demod_opts *opts = (struct demod_opts *)x;
+
+	return demod_init(opts->pll_bw, SYM_BW, opts->samplerate, opts->symrate,
+	                  opts->interp_factor, opts->rrc_order, opts->oqpsk, opts->freq_max,
+	                  opts->decim, opts->acq, opts->fixed, opts->cubic, opts->gardner,
+	                  opts->pre_agc);
+}
+
+/**
+ * Two-pass mode: demodulate the recording with a separate demodulator until
+ * the PLL has been locked for PREPASS_LOCK_SECS, and take a snapshot of its
+ * estimates at that point
+ *
+ * @return 0 on success, 1 if the PLL never locked or on failure
+ */
+static int
+prepass(volatile struct thropts *parms, FILE *fd, int bps, uint64_t start, uint64_t end, DemodState *state, uint64_t *lock_pos)
+{
+	float complex buf[BLOCKSIZE], symbols[BLOCKSIZE];
+	int16_t raw_buf[2*BLOCKSIZE];
+	const float complex *samples;
+	const int16_t *raw;
+	const uint64_t lock_len = PREPASS_LOCK_SECS * parms->opts->samplerate;
+	Demod *dem;
+	Source *src;
+	uint64_t pos;
+	size_t count;
+	int ret, locked;
+
+	if (!(dem = create_demod(parms->opts))) return 1;
+	if (!(src = source_open_range(fd, bps, start, end))) {
+		demod_deinit(dem);
+		return 1;
+	}
+
+	ret = 1;
+	pos = locked = 0;
+	while (!parms->done) {
+		count = BLOCKSIZE;
+		if (parms->demod_s16) {
+			raw = source_read_s16(src, raw_buf, &count);
+			if (!count) break;
+			parms->demod_s16(dem, symbols, raw, count);
+		} else {
+			samples = source_read(src, buf, &count);
+			if (!count) break;
+			parms->demod(dem, symbols, samples, count);
+		}
+		pos += count;
+
+		/* Only trust the estimates once the lock is stable */
+		if (!pll_get_locked(&dem->pll)) {
+			locked = 0;
+		} else if (!locked) {
+			locked = 1;
+			*lock_pos = pos;
+		} else if (pos - *lock_pos >= lock_len) {
+			demod_get_state(dem, state);
+			ret = 0;
+			break;
+		}
+	}
+
+	source_close(src);
+	demod_deinit(dem);
+	return ret;
+}
+
+/**
+ * Convert symbols to 8-bit soft symbols and hand them to the encoder in
+ * RINGSIZE chunks
+ */
+static void
+write_symbols(volatile struct thropts *parms, const float complex *symbols, size_t count, int locked_once)
+{
+	size_t i;
+	unsigned ring_idx = parms->ring_idx;
+
+	for (i=0; i<count; i++) {
+		_symbols_ring[ring_idx++] = MAX(-127, MIN(127, crealf(symbols[i])/2));
+		_symbols_ring[ring_idx++] = MAX(-127, MIN(127, cimagf(symbols[i])/2));
+
+		if (ring_idx >= LEN(_symbols_ring)) {
+			ring_idx = 0;
+
+			/* Only write symbols after the PLL locked once */
+			if (locked_once || parms->write_all) {
+				encoder_write(parms->enc, _symbols_ring, LEN(_symbols_ring));
+				__atomic_store_n(&parms->bytes_out, parms->enc->bytes, __ATOMIC_RELAXED);
+			}
+		}
+	}
+
+	parms->ring_idx = ring_idx;
+}
+
+/**
+ * Record the symbols just demodulated, and every TELEMETRY_INTERVAL symbols,
+ * publish a snapshot of the demodulator state for the status display. Must
+ * only be called by the thread running the demodulator
+ */
+static void
+update_telemetry(const Demod *dem, const Source *src, const float complex *symbols, size_t count, uint64_t offset)
+{
+	if (telemetry_push_symbols(&_telemetry, symbols, count)) publish_telemetry(dem, src, offset);
+}
+
+/**
+ * Publish a snapshot of the demodulator state for the status display
+ */
+static void
+publish_telemetry(const Demod *dem, const Source *src, uint64_t offset)
+{
+	TelemetryData *data;
+
+	data = telemetry_begin_write(&_telemetry);
+	data->carrier_freq = pll_get_freq(&dem->pll);
+	data->symbol_freq = mm_omega(&dem->timing);
+	data->gain = demod_get_gain(dem);
+	data->locked = pll_get_locked(&dem->pll);
+	data->offset = offset;
+	if (src->net) {
+		net_get_stats(src->net, &data->net);
+	} else {
+		memset(&data->net, 0, sizeof(data->net));
+	}
+#ifdef ENABLE_PROFILING
+	prof_copy(&data->prof, &dem->prof);
+#endif
+	telemetry_publish(&_telemetry);
+}
+
+/**
+ * Live mode: halve the RRC filter order, down to LIVE_MIN_ORDER, whenever the
+ * demodulator falls behind the input. The demodulator thread picks the new
+ * order up at the start of its next block
+ *
+ * @return the new filter order, 0 if unchanged
+ */
+static int
+shed_load(volatile struct thropts *parms, const Live *live)
+{
+	int order;
+
+	order = parms->rrc_order;
+	if (order <= LIVE_MIN_ORDER || !live_behind(live, LIVE_SHED_BACKLOG)) return 0;
+
+	order = MAX(LIVE_MIN_ORDER, order/2);
+	__atomic_store_n(&parms->rrc_order, order, __ATOMIC_RELAXED);
+	return order;
+}
+
+/**
+ * Write out any leftover symbols and notify the main thread
+ */
+static void
+flush_symbols(volatile struct thropts *parms)
+{
+	/* Flush output buffer */
+	encoder_write(parms->enc, _symbols_ring, parms->ring_idx);
+	encoder_flush(parms->enc);
+	__atomic_store_n(&parms->bytes_out, parms->enc->bytes, __ATOMIC_RELAXED);
+	parms->done = 1;
+
+	/* Wake up main thread */
+	pthread_kill(parms->main_tid, SIGUSR1);
+}
 /* }}} */
@@ -0,0 +1,379 @@
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "net.h"
+#include "utils.h"
+
+#define RTLTCP_CMD_FREQ 0x01
+#define RTLTCP_CMD_SAMPLERATE 0x02
+#define UDP_HEADER_SIZE 4
+#define UDP_RCVBUF (4 * 1024 * 1024)
+#define UDP_RESYNC_GAP 1024       /* Packets past the jitter buffer still filled with silence */
+
+static int net_connect(const char *host, const char *port, int udp);
+static int split_url(const char *url, const char *scheme, char *host, size_t host_len, const char **port);
+static int rtltcp_handshake(NetSource *net, int samplerate, uint32_t freq);
+static int rtltcp_command(int fd, uint8_t cmd, uint32_t param);
+static size_t tcp_read(NetSource *net, uint8_t *buf, size_t len);
+static size_t udp_read(NetSource *net, uint8_t *buf, size_t len);
+static int udp_receive(NetSource *net);
+static void udp_store(NetSource *net, uint32_t seq, const uint8_t *data, size_t len);
+static void udp_resync(NetSource *net, uint32_t seq);
+static size_t recv_all(int fd, uint8_t *buf, size_t len);
+static void stat_inc(uint64_t *counter);
+
+int
+net_is_url(const char *name)
+{
+	return !strncmp(name, "rtl_tcp://", strlen("rtl_tcp://"))
+	    || !strncmp(name, "udp://", strlen("udp://"));
+}
+
+NetSource*
+net_open(const char *url, int samplerate, uint32_t freq, int bps, unsigned depth)
+{
+	NetSource *net;
+	char host[256];
+	const char *port;
+	int udp;
+
+	udp = !strncmp(url, "udp://", strlen("udp://"));
+	if (split_url(url, udp ? "udp://" : "rtl_tcp://", host, sizeof(host), &port)) return NULL;
+	if (!port) {
+		if (udp) return NULL;   /* No sensible default port for UDP */
+		port = NET_RTLTCP_PORT;
+	}
+
+	if (!(net = calloc(1, sizeof(*net)))) return NULL;
+	net->udp = udp;
+	net->silence = bps == 8 ? 0x80 : 0;
+	net->depth = MAX(1, depth);
+
+	if ((net->fd = net_connect(host, port, udp)) < 0) {
+		free(net);
+		return NULL;
+	}
+
+	if (udp) {
+		net->slots = malloc(net->depth * NET_MAX_PAYLOAD);
+		net->slot_len = calloc(net->depth, sizeof(*net->slot_len));
+		net->held = malloc(UDP_HEADER_SIZE + NET_MAX_PAYLOAD);
+		if (!net->slots || !net->slot_len || !net->held) {
+			net_close(net);
+			return NULL;
+		}
+	} else if (rtltcp_handshake(net, samplerate, freq)) {
+		net_close(net);
+		return NULL;
+	}
+
+	return net;
+}
+
+size_t
+net_read(NetSource *net, uint8_t *buf, size_t len)
+{
+	return net->udp ? udp_read(net, buf, len) : tcp_read(net, buf, len);
+}
+
+void
+net_get_stats(const NetSource *net, NetStats *stats)
+{
+	stats->packets = __atomic_load_n(&net->stats.packets, __ATOMIC_RELAXED);
+	stats->dropped = __atomic_load_n(&net->stats.dropped, __ATOMIC_RELAXED);
+	stats->late = __atomic_load_n(&net->stats.late, __ATOMIC_RELAXED);
+	stats->resyncs = __atomic_load_n(&net->stats.resyncs, __ATOMIC_RELAXED);
+}
+
+void
+net_close(NetSource *net)
+{
+	if (net->fd >= 0) close(net->fd);
+	free(net->slots);
+	free(net->slot_len);
+	free(net->held);
+	free(net);
+}
+
+/* Static functions {{{ */
+/**
+ * Resolve an address and either connect to it (TCP) or bind to it (UDP)
+ *
+ * @return socket file descriptor on success, -1 on failure
+ */
+static int
+net_connect(const char *host, const char *port, int udp)
+{
+	struct addrinfo hints, *res, *ai;
+	int fd, rcvbuf;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = udp ? SOCK_DGRAM : SOCK_STREAM;
+	hints.ai_flags = udp ? AI_PASSIVE : 0;
+
+	if (getaddrinfo(*host ? host : NULL, port, &hints, &res)) return -1;
+
+	fd = -1;
+	for (ai = res; ai; ai = ai->ai_next) {
+		if ((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0) continue;
+
+		if (udp) {
+			/* Give the kernel room to queue datagrams while the demodulator
+			 * is busy, since they're lost otherwise */
+			rcvbuf = UDP_RCVBUF;
+			setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+			if (!bind(fd, ai->ai_addr, ai->ai_addrlen)) break;
+		} else {
+			if (!connect(fd, ai->ai_addr, ai->ai_addrlen)) break;
+		}
+
+		close(fd);
+		fd = -1;
+	}
+
+	freeaddrinfo(res);
+	return fd;
+}
+
+/**
+ * Split a scheme://host[:port] URL into its components. IPv6 addresses must
+ * be enclosed in brackets
+ *
+ * @return 0 on success, 1 if the URL is malformed
+ */
+static int
+split_url(const char *url, const char *scheme, char *host, size_t host_len, const char **port)
+{
+	const char *start, *end;
+
+	start = url + strlen(scheme);
+	if (*start == '[') {
+		start++;
+		if (!(end = strchr(start, ']'))) return 1;
+		*port = end[1] == ':' ? end + 2 : NULL;
+	} else {
+		end = strchr(start, ':');
+		*port = end ? end + 1 : NULL;
+		if (!end) end = start + strlen(start);
+	}
+
+	if ((size_t)(end - start) >= host_len) return 1;
+	memcpy(host, start, end - start);
+	host[end - start] = '\0';
+
+	if (*port && !**port) *port = NULL;
+	return 0;
+}
+
+/**
+ * Read the dongle info a rtl_tcp server sends upon connection, and apply the
+ * requested settings
+ *
+ * @return 0 on success, 1 on failure
+ */
+static int
+rtltcp_handshake(NetSource *net, int samplerate, uint32_t freq)
+{
+	uint8_t info[12];   /* "RTL0", tuner type, gain count */
+
+	if (recv_all(net->fd, info, sizeof(info)) != sizeof(info)) return 1;
+	if (memcmp(info, "RTL0", 4)) return 1;
+
+	if (samplerate > 0 && rtltcp_command(net->fd, RTLTCP_CMD_SAMPLERATE, samplerate)) return 1;
+	if (freq > 0 && rtltcp_command(net->fd, RTLTCP_CMD_FREQ, freq)) return 1;
+
+	return 0;
+}
+
+static int
+rtltcp_command(int fd, uint8_t cmd, uint32_t param)
+{
+	uint8_t buf[5];
+
+	/* Command byte followed by a big-endian parameter */
+	buf[0] = cmd;
+	buf[1] = param >> 24;
+	buf[2] = param >> 16;
+	buf[3] = param >> 8;
+	buf[4] = param;
+
+	return send(fd, buf, sizeof(buf), 0) != sizeof(buf);
+}
+
+static size_t
+tcp_read(NetSource *net, uint8_t *buf, size_t len)
+{
+	len = recv_all(net->fd, buf, len);
+	if (len > 0) stat_inc(&net->stats.packets);
+	return len;
+}
+
+/**
+ * Hand out data from the jitter buffer in sequence order, receiving more
+ * datagrams whenever the next one in line is not there yet
+ */
+static size_t
+udp_read(NetSource *net, uint8_t *buf, size_t len)
+{
+	size_t total, slot, chunk;
+
+	total = 0;
+	while (total < len) {
+		slot = net->next_seq % net->depth;
+
+		/* Next packet available: copy as much of it as possible */
+		if (net->started && net->slot_len[slot]) {
+			chunk = MIN(len - total, net->slot_len[slot] - net->read_offset);
+			memcpy(buf + total, net->slots + slot*NET_MAX_PAYLOAD + net->read_offset, chunk);
+			total += chunk;
+			net->read_offset += chunk;
+
+			if (net->read_offset == net->slot_len[slot]) {
+				net->slot_len[slot] = 0;
+				net->read_offset = 0;
+				net->next_seq++;
+			}
+			continue;
+		}
+
+		/* A packet too far ahead is waiting to be stored. If there's room
+		 * for it now, store it, otherwise give up on the one we're waiting
+		 * for and replace it with silence */
+		if (net->held_len) {
+			if (net->held_seq - net->next_seq < net->depth) {
+				udp_store(net, net->held_seq, net->held + UDP_HEADER_SIZE, net->held_len);
+				net->held_len = 0;
+			} else {
+				memset(net->slots + slot*NET_MAX_PAYLOAD, net->silence, net->last_len);
+				net->slot_len[slot] = net->last_len;
+				stat_inc(&net->stats.dropped);
+			}
+			continue;
+		}
+
+		if (udp_receive(net)) break;
+	}
+
+	return total;
+}
+
+/**
+ * Receive a datagram and file it into the jitter buffer
+ *
+ * @return 0 on success, 1 on timeout or error
+ */
+static int
+udp_receive(NetSource *net)
+{
+	const struct timeval timeout = {NET_UDP_TIMEOUT, 0};
+	ssize_t len;
+	uint32_t seq;
+	int32_t ahead;
+
+	do {
+		len = recv(net->fd, net->held, UDP_HEADER_SIZE + NET_MAX_PAYLOAD, 0);
+	} while (len < 0 && errno == EINTR);
+
+	if (len < 0) return 1;
+	if (len <= UDP_HEADER_SIZE) return 0;   /* Ignore runt packets */
+
+	seq = net->held[0] | net->held[1] << 8 | net->held[2] << 16 | (uint32_t)net->held[3] << 24;
+	len -= UDP_HEADER_SIZE;
+	stat_inc(&net->stats.packets);
+	net->last_len = len;
+
+	/* The first packet defines where the stream starts. From then on, stop
+	 * waiting forever if the sender goes away */
+	if (!net->started) {
+		net->started = 1;
+		net->next_seq = seq;
+		setsockopt(net->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	}
+
+	/* A sequence number way off from the expected one means that the sender
+	 * restarted or skipped ahead: start over from it, instead of reporting
+	 * the rest of the stream as late or filling the gap with silence */
+	ahead = (int32_t)(seq - net->next_seq);
+	if (ahead < -(int32_t)net->depth || ahead >= (int32_t)net->depth + UDP_RESYNC_GAP) {
+		udp_resync(net, seq);
+		ahead = 0;
+	}
+
+	if (ahead < 0) {
+		/* Already handed out (or replaced with silence) */
+		stat_inc(&net->stats.late);
+	} else if ((uint32_t)ahead < net->depth) {
+		udp_store(net, seq, net->held + UDP_HEADER_SIZE, len);
+	} else {
+		/* Too far ahead, keep it around until the buffer catches up */
+		net->held_seq = seq;
+		net->held_len = len;
+	}
+
+	return 0;
+}
+
+static void
+udp_store(NetSource *net, uint32_t seq, const uint8_t *data, size_t len)
+{
+	const size_t slot = seq % net->depth;
+
+	if (net->slot_len[slot]) {
+		stat_inc(&net->stats.late);  /* Duplicate */
+		return;
+	}
+
+	memmove(net->slots + slot*NET_MAX_PAYLOAD, data, len);
+	net->slot_len[slot] = len;
+}
+
+/**
+ * Drop the contents of the jitter buffer and restart the stream from seq
+ */
+static void
+udp_resync(NetSource *net, uint32_t seq)
+{
+	memset(net->slot_len, 0, net->depth * sizeof(*net->slot_len));
+	net->next_seq = seq;
+	net->read_offset = 0;
+	stat_inc(&net->stats.resyncs);
+}
+
+/**
+ * Receive exactly len bytes from a stream socket
+ *
+ * @return number of bytes received, less than len on EOF or error
+ */
+static size_t
+recv_all(int fd, uint8_t *buf, size_t len)
+{
+	size_t total;
+	ssize_t n;
+
+	for (total = 0; total < len; total += n) {
+		n = recv(fd, buf + total, len - total, 0);
+		if (n < 0 && errno == EINTR) {
+			n = 0;
+			continue;
+		}
+		if (n <= 0) break;
+	}
+
+	return total;
+}
+
+/* Increment a statistics counter so that net_get_stats() can read it from
+ * another thread */
+static void
+stat_inc(uint64_t *counter)
+{
+	__atomic_store_n(counter, *counter + 1, __ATOMIC_RELAXED);
+}
+/* }}} */
@@ -0,0 +1,98 @@
+/**
+ * Network sample sources: rtl_tcp client, and raw I/Q over UDP with a jitter
+ * buffer to put reordered datagrams back in sequence
+ */
+#ifndef net_h
+#define net_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define NET_RTLTCP_PORT "1234"
+#define NET_JITTER_DEPTH 32         /* Default UDP jitter buffer size, in packets */
+#define NET_MAX_PAYLOAD 65507       /* Largest possible UDP payload */
+#define NET_UDP_TIMEOUT 5           /* Seconds without data before a UDP stream is considered over */
+
+typedef struct {
+	uint64_t packets;       /* Datagrams received */
+	uint64_t dropped;       /* Datagrams never received, replaced with silence */
+	uint64_t late;          /* Datagrams received after being given up on, or duplicates */
+	uint64_t resyncs;       /* Sequence number jumps that restarted the stream */
+} NetStats;
+
+typedef struct {
+	int fd;
+	int udp;
+	int silence;                /* Byte value that decodes to a zero sample */
+
+	/* UDP jitter buffer: packet with sequence number seq is stored in slot
+	 * seq % depth, as long as it's less than depth packets ahead */
+	uint8_t *slots;
+	size_t *slot_len;           /* 0 if the slot is empty */
+	unsigned depth;
+	uint32_t next_seq;          /* Next packet to hand out */
+	size_t read_offset;         /* Bytes already handed out from next_seq */
+	size_t last_len;            /* Size of the last packet received, used for lost ones */
+	int started;
+
+	/* Packet that didn't fit in the jitter buffer yet */
+	uint8_t *held;
+	size_t held_len;
+	uint32_t held_seq;
+
+	NetStats stats;
+} NetSource;
+
+/**
+ * Check whether an input name refers to a network source
+ *
+ * @param name input name, as passed on the command line
+ * @return 1 if name is a rtl_tcp:// or udp:// URL, 0 otherwise
+ */
+int net_is_url(const char *name);
+
+/**
+ * Open a network source. Two kinds of URLs are supported:
+ *   rtl_tcp://host[:port]  connect to a rtl_tcp server (8-bit samples)
+ *   udp://[host]:port      listen for datagrams, each made of a 32-bit
+ *                          little-endian sequence number followed by raw I/Q
+ *
+ * @param url URL of the source
+ * @param samplerate sample rate to request from a rtl_tcp server, 0 to keep
+ *        the server's
+ * @param freq frequency to tune a rtl_tcp server to in Hz, 0 to keep the
+ *        server's
+ * @param bps bits per sample of the stream, used to generate silence in place
+ *        of lost UDP packets
+ * @param depth UDP jitter buffer size, in packets
+ * @return network source on success, NULL on failure
+ */
+NetSource* net_open(const char *url, int samplerate, uint32_t freq, int bps, unsigned depth);
+
+/**
+ * Read raw sample data from a network source, blocking until either the
+ * buffer is full or the stream ends
+ *
+ * @param net source to read from
+ * @param buf buffer to write the data to
+ * @param len number of bytes to read
+ * @return number of bytes read, less than len on end of stream
+ */
+size_t net_read(NetSource *net, uint8_t *buf, size_t len);
+
+/**
+ * Get the statistics of a network source. Can be called from any thread
+ *
+ * @param net source to query
+ * @param stats where to write the statistics
+ */
+void net_get_stats(const NetSource *net, NetStats *stats);
+
+/**
+ * Close a network source
+ *
+ * @param net source to close
+ */
+void net_close(NetSource *net);
+
+#endif
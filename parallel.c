@@ -0,0 +1,374 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "parallel.h"
+#include "source.h"
+#include "utils.h"
+
+#define BLOCKSIZE 4096
+#define STITCH_WINDOW 1024      /* Symbols compared when aligning two chunks */
+#define STITCH_SEARCH 16        /* Max boundary misalignment, in symbols */
+#define STITCH_MIN_SCORE 0.5    /* Min normalized correlation to trust an alignment */
+
+/* Sequential mode buffers soft symbols in chunks of this many bytes (2*RINGSIZE
+ * in main.c), and writes out every chunk completed once the PLL has locked */
+#define LOCK_ALIGN 1024
+
+typedef struct {
+	/* Input parameters */
+	FILE *fd;
+	int bps;
+	uint64_t data_start;
+	uint64_t leadin_start, start, end, overlap_end;   /* In samples */
+	size_t (*demod)(Demod *dem, float complex *dst, const float complex *src, size_t count);
+	Demod* (*create)(void *arg);
+	void *arg;
+	volatile uint64_t *progress;
+
+	/* Results */
+	int8_t *syms;
+	size_t len, cap;
+	size_t boundary, end_boundary;  /* Symbol bytes produced at start/end */
+	long first_lock;                /* Symbol bytes produced before the block the PLL first locked in */
+	int failed;
+
+	/* Stitching */
+	size_t cut_start;
+	int rot;                        /* QPSK: rotation, in multiples of 90deg */
+	int sign[2];                    /* OQPSK: sign of even/odd output bytes */
+} Chunk;
+
+static void* chunk_worker(void *x);
+static int chunk_run(Chunk *chunk, Demod *dem, Source *src, uint64_t *pos, uint64_t target);
+static int chunk_append(Chunk *chunk, const float complex *symbols, size_t count);
+static void stitch_qpsk(const Chunk *prev, Chunk *next);
+static void stitch_oqpsk(const Chunk *prev, Chunk *next, size_t out_pos);
+static void rotate(int8_t *dst, const int8_t *src, int rot);
+
+long
+parallel_demod(FILE *fd, int bps, int samplerate, int symrate, int jobs,
+               size_t (*demod)(Demod *dem, float complex *dst, const float complex *src, size_t count),
+               Demod* (*create)(void *arg), void *arg,
+               Encoder *out, volatile uint64_t *progress)
+{
+	const size_t sample_size = 2*bps/8;
+	const uint64_t leadin = PARALLEL_LEADIN_SECS * samplerate;
+	const uint64_t overlap = (uint64_t)PARALLEL_OVERLAP * samplerate / symrate;
+	Chunk *chunks;
+	pthread_t *tids;
+	struct stat st;
+	uint64_t nsamples, chunk_len;
+	size_t out_pos, end, i;
+	long data_start, written;
+	int8_t tmp[2];
+	int k, first, oqpsk;
+
+	if ((data_start = ftell(fd)) < 0 || fstat(fileno(fd), &st)) return -1;
+	nsamples = (st.st_size - data_start) / sample_size;
+	chunk_len = nsamples / jobs;
+
+	if (!(chunks = calloc(jobs, sizeof(*chunks)))) return -1;
+	if (!(tids = calloc(jobs, sizeof(*tids)))) {
+		free(chunks);
+		return -1;
+	}
+
+	/* Split the file into chunks and start demodulating them */
+	for (k=0; k<jobs; k++) {
+		chunks[k].fd = fd;
+		chunks[k].bps = bps;
+		chunks[k].data_start = data_start;
+		chunks[k].start = k * chunk_len;
+		chunks[k].end = (k == jobs-1) ? nsamples : (k+1) * chunk_len;
+		chunks[k].leadin_start = chunks[k].start - MIN(leadin, chunks[k].start);
+		chunks[k].overlap_end = MIN(nsamples, chunks[k].end + overlap);
+		chunks[k].demod = demod;
+		chunks[k].create = create;
+		chunks[k].arg = arg;
+		chunks[k].progress = progress;
+		chunks[k].first_lock = -1;
+
+		pthread_create(&tids[k], NULL, chunk_worker, &chunks[k]);
+	}
+
+	for (k=0; k<jobs; k++) {
+		pthread_join(tids[k], NULL);
+	}
+	free(tids);
+
+	/* Skip all chunks that never locked, mimicking the sequential behavior of
+	 * discarding symbols until the PLL locks for the first time */
+	for (first=0; first<jobs && (chunks[first].failed || chunks[first].first_lock < 0); first++)
+		;
+
+	/* Stitch the chunks together */
+	oqpsk = demod == demod_oqpsk_block;
+	written = 0;
+	out_pos = 0;
+	for (k=first; k<jobs; k++) {
+		if (chunks[k].failed) {
+			written = -1;
+			break;
+		}
+
+		if (k == first) {
+			/* Start where sequential mode would */
+			chunks[k].cut_start = MIN((size_t)chunks[k].first_lock / LOCK_ALIGN * LOCK_ALIGN, chunks[k].end_boundary);
+			chunks[k].rot = 0;
+			chunks[k].sign[0] = chunks[k].sign[1] = 1;
+		} else if (oqpsk) {
+			stitch_oqpsk(&chunks[k-1], &chunks[k], out_pos);
+		} else {
+			stitch_qpsk(&chunks[k-1], &chunks[k]);
+		}
+
+		/* Write out the chunk, correcting the phase ambiguity. OQPSK chunks
+		 * can be cut on either byte of a symbol, so they're written a byte at
+		 * a time to keep the I/Q pairing of the output stream, and the last
+		 * one is trimmed so that the output ends on a whole symbol */
+		if (oqpsk) {
+			end = chunks[k].end_boundary;
+			if (k == jobs-1 && (out_pos + end - chunks[k].cut_start) & 1) end--;
+			for (i=chunks[k].cut_start; i<end; i++, out_pos++) {
+				tmp[0] = chunks[k].syms[i] * chunks[k].sign[out_pos & 1];
+				encoder_write(out, tmp, 1);
+				written++;
+			}
+		} else {
+			for (i=chunks[k].cut_start; i+1<chunks[k].end_boundary; i+=2, out_pos+=2) {
+				rotate(tmp, &chunks[k].syms[i], chunks[k].rot);
+				encoder_write(out, tmp, 2);
+				written += 2;
+			}
+		}
+	}
+
+	for (k=0; k<jobs; k++) {
+		free(chunks[k].syms);
+	}
+	free(chunks);
+
+	return written;
+}
+
+/* Static functions {{{ */
+/**
+ * Demodulate a single chunk, keeping track of the position of the nominal
+ * chunk boundaries within the symbol stream
+ */
+static void*
+chunk_worker(void *x)
+{
+	Chunk *chunk = (Chunk*)x;
+	const size_t sample_size = 2*chunk->bps/8;
+	Source *src;
+	Demod *dem;
+	uint64_t pos;
+
+	chunk->failed = 1;
+	if (chunk->overlap_end <= chunk->leadin_start) return NULL;
+
+	if (!(dem = chunk->create(chunk->arg))) return NULL;
+	if (!(src = source_open_range(chunk->fd, chunk->bps,
+	                              chunk->data_start + chunk->leadin_start * sample_size,
+	                              chunk->data_start + chunk->overlap_end * sample_size))) {
+		demod_deinit(dem);
+		return NULL;
+	}
+
+	/* Keep track of where the nominal start and end of the chunk fall within
+	 * the symbol stream */
+	pos = chunk->leadin_start;
+	chunk->failed = chunk_run(chunk, dem, src, &pos, chunk->start);
+	chunk->boundary = chunk->len;
+	if (!chunk->failed) chunk->failed = chunk_run(chunk, dem, src, &pos, chunk->end);
+	chunk->end_boundary = chunk->len;
+	if (!chunk->failed) chunk->failed = chunk_run(chunk, dem, src, &pos, chunk->overlap_end);
+
+	source_close(src);
+	demod_deinit(dem);
+	return NULL;
+}
+
+/**
+ * Demodulate samples until the given position is reached
+ *
+ * @return 0 on success, 1 on failure
+ */
+static int
+chunk_run(Chunk *chunk, Demod *dem, Source *src, uint64_t *pos, uint64_t target)
+{
+	const size_t sample_size = 2*chunk->bps/8;
+	float complex buf[BLOCKSIZE], symbols[BLOCKSIZE];
+	const float complex *samples;
+	size_t count, nsyms, len;
+
+	while (*pos < target) {
+		count = MIN(BLOCKSIZE, target - *pos);
+		samples = source_read(src, buf, &count);
+		if (!count) break;
+
+		nsyms = chunk->demod(dem, symbols, samples, count);
+		len = chunk->len;
+		if (chunk_append(chunk, symbols, nsyms)) return 1;
+
+		if (chunk->first_lock < 0 && pll_did_lock_once(&dem->pll)) {
+			chunk->first_lock = len;
+		}
+
+		*pos += count;
+		__atomic_fetch_add(chunk->progress, count * sample_size, __ATOMIC_RELAXED);
+	}
+
+	return 0;
+}
+
+/**
+ * Convert symbols to 8-bit soft symbols and append them to the chunk
+ *
+ * @return 0 on success, 1 on failure
+ */
+static int
+chunk_append(Chunk *chunk, const float complex *symbols, size_t count)
+{
+	int8_t *tmp;
+	size_t i;
+
+	if (chunk->len + 2*count > chunk->cap) {
+		chunk->cap = MAX(2*chunk->cap, chunk->len + 2*count);
+		if (!(tmp = realloc(chunk->syms, chunk->cap))) return 1;
+		chunk->syms = tmp;
+	}
+
+	for (i=0; i<count; i++) {
+		chunk->syms[chunk->len++] = MAX(-127, MIN(127, crealf(symbols[i])/2));
+		chunk->syms[chunk->len++] = MAX(-127, MIN(127, cimagf(symbols[i])/2));
+	}
+
+	return 0;
+}
+
+/**
+ * Align a QPSK chunk to the previous one: find the offset and the 90deg
+ * rotation that best match the overlapping symbols
+ */
+static void
+stitch_qpsk(const Chunk *prev, Chunk *next)
+{
+	const int8_t *ref = prev->syms + prev->end_boundary;
+	int8_t rotated[2];
+	size_t window, i;
+	long score, best_score, energy;
+	int d, r, best_d, best_r;
+
+	window = MIN(STITCH_WINDOW, (prev->len - prev->end_boundary)/2);
+	window = MIN(window, (next->len - MIN(next->len, next->boundary + 2*STITCH_SEARCH))/2);
+
+	best_d = 0;
+	best_r = 0;
+	best_score = 0;
+	if (next->boundary >= 2*STITCH_SEARCH) {
+		for (d=-STITCH_SEARCH; d<=STITCH_SEARCH; d++) {
+			for (r=0; r<4; r++) {
+				score = 0;
+				for (i=0; i<window; i++) {
+					rotate(rotated, &next->syms[next->boundary + 2*(i+d)], r);
+					score += ref[2*i] * rotated[0] + ref[2*i+1] * rotated[1];
+				}
+				if (score > best_score) {
+					best_score = score;
+					best_d = d;
+					best_r = r;
+				}
+			}
+		}
+	}
+
+	/* If the chunks don't match (e.g. no signal), just cut at the nominal
+	 * boundary */
+	for (energy=0, i=0; i<2*window; i++) energy += ref[i] * ref[i];
+	if (!energy || best_score < STITCH_MIN_SCORE * energy) {
+		best_d = 0;
+		best_r = 0;
+	}
+
+	next->cut_start = next->boundary + 2*best_d;
+	next->rot = (prev->rot + best_r) % 4;
+}
+
+/**
+ * Align an OQPSK chunk to the previous one. Because I and Q are offset by half
+ * a symbol, a 90deg rotation of the carrier phase shows up as a half-symbol
+ * shift of the interleaved I/Q stream plus a sign change on either branch, so
+ * the search is done on individual bytes with independent signs for even and
+ * odd output positions
+ */
+static void
+stitch_oqpsk(const Chunk *prev, Chunk *next, size_t out_pos)
+{
+	const int8_t *ref = prev->syms + prev->end_boundary;
+	size_t window, i;
+	long score[2], best_score[2], energy;
+	int d, p, best_d;
+
+	window = MIN(2*STITCH_WINDOW, prev->len - prev->end_boundary);
+	window = MIN(window, next->len - MIN(next->len, next->boundary + 2*STITCH_SEARCH));
+
+	best_d = 0;
+	best_score[0] = best_score[1] = 0;
+	if (next->boundary >= 2*STITCH_SEARCH) {
+		for (d=-2*STITCH_SEARCH; d<=2*STITCH_SEARCH; d++) {
+			score[0] = score[1] = 0;
+			for (i=0; i<window; i++) {
+				score[(out_pos + i) & 1] += ref[i] * next->syms[next->boundary + i + d];
+			}
+			if (labs(score[0]) + labs(score[1]) > labs(best_score[0]) + labs(best_score[1])) {
+				best_score[0] = score[0];
+				best_score[1] = score[1];
+				best_d = d;
+			}
+		}
+	}
+
+	for (energy=0, i=0; i<window; i++) energy += ref[i] * ref[i];
+	if (!energy || labs(best_score[0]) + labs(best_score[1]) < STITCH_MIN_SCORE * energy) {
+		best_d = 0;
+		best_score[0] = best_score[1] = 1;
+	}
+
+	next->cut_start = next->boundary + best_d;
+	for (p=0; p<2; p++) {
+		next->sign[p] = prev->sign[p] * sgn(best_score[p]);
+	}
+}
+
+/**
+ * Rotate a soft symbol by a multiple of 90 degrees
+ */
+static void
+rotate(int8_t *dst, const int8_t *src, int rot)
+{
+	switch (rot) {
+		case 0:
+			dst[0] = src[0];
+			dst[1] = src[1];
+			break;
+		case 1:
+			dst[0] = -src[1];
+			dst[1] = src[0];
+			break;
+		case 2:
+			dst[0] = -src[0];
+			dst[1] = -src[1];
+			break;
+		case 3:
+			dst[0] = src[1];
+			dst[1] = -src[0];
+			break;
+		default:
+			break;
+	}
+}
+/* }}} */
@@ -0,0 +1,41 @@
+/**
+ * Parallel offline demodulation: split a recording into chunks, demodulate
+ * them concurrently, and stitch the resulting symbol streams back together
+ */
+#ifndef parallel_h
+#define parallel_h
+
+#include <stdint.h>
+#include <stdio.h>
+#include "demod.h"
+#include "encoder.h"
+
+/* Lead-in before each chunk, giving the AGC, PLL and M&M loops time to
+ * converge before the symbols start counting */
+#define PARALLEL_LEADIN_SECS 2.0
+/* Extra symbols demodulated past the end of each chunk, used to align it to the
+ * following chunk */
+#define PARALLEL_OVERLAP 4096
+
+/**
+ * Demodulate a recording stored in a regular file by splitting it into chunks
+ * and processing them on separate threads
+ *
+ * @param fd recording, positioned at the start of the raw samples
+ * @param bps bits per sample
+ * @param samplerate input sample rate
+ * @param symrate symbol rate
+ * @param jobs number of chunks to split the file into
+ * @param demod demodulation function (demod_qpsk_block or demod_oqpsk_block)
+ * @param create callback creating a new, independent demodulator
+ * @param arg argument passed to create()
+ * @param out encoder to send the 8-bit soft symbols to
+ * @param progress updated with the number of bytes of input processed so far
+ * @return number of soft symbols written, or -1 on failure
+ */
+long parallel_demod(FILE *fd, int bps, int samplerate, int symrate, int jobs,
+                    size_t (*demod)(Demod *dem, float complex *dst, const float complex *src, size_t count),
+                    Demod* (*create)(void *arg), void *arg,
+                    Encoder *out, volatile uint64_t *progress);
+
+#endif
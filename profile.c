@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <time.h>
+#include "profile.h"
+
+static const char *_stage_names[PROF_STAGES] = {
+	[PROF_READ] = "read",
+	[PROF_DECIM] = "decim",
+	[PROF_FILTER] = "filter",
+	[PROF_AGC] = "agc",
+	[PROF_PLL_MIX] = "pll_mix",
+	[PROF_RETIME] = "retime",
+	[PROF_PLL_UPDATE] = "pll_update",
+	[PROF_WRITE] = "write",
+};
+
+static uint64_t total_ticks(const Profile *prof);
+
+#ifndef prof_ticks
+uint64_t
+prof_ticks(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+#endif
+
+void
+prof_copy(Profile *dst, const Profile *src)
+{
+	int i;
+
+	for (i=0; i<PROF_STAGES; i++) {
+		dst->ticks[i] = __atomic_load_n(&src->ticks[i], __ATOMIC_RELAXED);
+		dst->calls[i] = __atomic_load_n(&src->calls[i], __ATOMIC_RELAXED);
+	}
+}
+
+void
+prof_format(const Profile *prof, char *buf, size_t len)
+{
+	const uint64_t total = total_ticks(prof);
+	size_t written;
+	int i, ret;
+
+	written = 0;
+	buf[0] = '\0';
+	for (i=0; i<PROF_STAGES && written < len; i++) {
+		if (!prof->calls[i]) continue;
+
+		ret = snprintf(buf + written, len - written, "%s%s %.1f%%",
+		               written ? " " : "", _stage_names[i],
+		               total ? 100.0 * prof->ticks[i] / total : 0);
+		if (ret < 0) break;
+		written += ret;
+	}
+}
+
+void
+prof_summary(const Profile *prof, FILE *fd)
+{
+	const uint64_t total = total_ticks(prof);
+	int i;
+
+	if (!total) return;
+
+	fprintf(fd, "%-12s %14s %16s %12s %7s\n", "Stage", "Calls", PROF_UNIT, PROF_UNIT "/call", "Share");
+	for (i=0; i<PROF_STAGES; i++) {
+		if (!prof->calls[i]) continue;
+
+		fprintf(fd, "%-12s %14llu %16llu %12.1f %6.1f%%\n",
+		        _stage_names[i],
+		        (unsigned long long)prof->calls[i],
+		        (unsigned long long)prof->ticks[i],
+		        (double)prof->ticks[i] / prof->calls[i],
+		        100.0 * prof->ticks[i] / total);
+	}
+}
+
+/* Static functions {{{ */
+static uint64_t
+total_ticks(const Profile *prof)
+{
+	uint64_t total;
+	int i;
+
+	total = 0;
+	for (i=0; i<PROF_STAGES; i++) {
+		total += prof->ticks[i];
+	}
+
+	return total;
+}
+/* }}} */
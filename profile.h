@@ -0,0 +1,92 @@
+/**
+ * Per-stage profiling counters, only compiled in with -DENABLE_PROFILING
+ */
+#ifndef profile_h
+#define profile_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define prof_ticks() __rdtsc()
+#define PROF_UNIT "cycles"
+#else
+#define PROF_UNIT "ns"
+#endif
+
+/* Each stage must only ever be updated by a single thread */
+enum {
+	PROF_READ,          /* Reading and converting samples */
+	PROF_DECIM,
+	PROF_FILTER,
+	PROF_AGC,
+	PROF_PLL_MIX,
+	PROF_RETIME,
+	PROF_PLL_UPDATE,
+	PROF_WRITE,         /* Converting and writing symbols */
+	PROF_STAGES
+};
+
+typedef struct {
+	uint64_t ticks[PROF_STAGES];
+	uint64_t calls[PROF_STAGES];
+} Profile;
+
+/* Time a statement, adding the elapsed ticks to the given stage. Without
+ * ENABLE_PROFILING this expands to the statement alone */
+#ifdef ENABLE_PROFILING
+#define PROFILE(prof, stage, stmt) do {                       \
+		const uint64_t _prof_start = prof_ticks();            \
+		stmt;                                                 \
+		prof_add(&(prof)->ticks[stage], prof_ticks() - _prof_start); \
+		prof_add(&(prof)->calls[stage], 1);                   \
+	} while (0)
+#else
+#define PROFILE(prof, stage, stmt) stmt
+#endif
+
+/* Each counter has a single writer, so a relaxed store is enough for
+ * prof_copy() to read it from another thread without tearing */
+static inline void
+prof_add(uint64_t *counter, uint64_t delta)
+{
+	__atomic_store_n(counter, *counter + delta, __ATOMIC_RELAXED);
+}
+
+#ifndef prof_ticks
+/**
+ * Read a monotonic timestamp, for architectures without a cycle counter
+ *
+ * @return time in nanoseconds
+ */
+uint64_t prof_ticks(void);
+#endif
+
+/**
+ * Copy the counters, which may be updated by other threads in the meantime
+ *
+ * @param dst where to copy the counters
+ * @param src counters to copy
+ */
+void prof_copy(Profile *dst, const Profile *src);
+
+/**
+ * Format the share of time spent in each stage as a single line
+ *
+ * @param prof counters to format
+ * @param buf buffer to write the string to
+ * @param len size of the buffer
+ */
+void prof_format(const Profile *prof, char *buf, size_t len);
+
+/**
+ * Write a table with the counters for each stage
+ *
+ * @param prof counters to print
+ * @param fd file to write the table to
+ */
+void prof_summary(const Profile *prof, FILE *fd);
+
+#endif
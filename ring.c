@@ -0,0 +1,95 @@
+#include <sched.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ring.h"
+
+/* Number of times to spin before yielding/sleeping while waiting */
+#define SPIN_COUNT 64
+#define SLEEP_NS 50000
+
+static void backoff(unsigned *iter);
+
+int
+ring_init(Ring *ring, size_t nslots, size_t slot_size, const volatile int *cancel)
+{
+	void *mem;
+
+	if (!nslots || (nslots & (nslots - 1))) return 1;
+
+	/* Round slots up to whole cache lines */
+	slot_size = (slot_size + CACHELINE_SIZE - 1) / CACHELINE_SIZE * CACHELINE_SIZE;
+	if (posix_memalign(&mem, CACHELINE_SIZE, nslots * slot_size)) return 1;
+
+	ring->slots = mem;
+	ring->slot_size = slot_size;
+	ring->nslots = nslots;
+	ring->cancel = cancel;
+	ring->head = ring->tail = 0;
+
+	return 0;
+}
+
+void
+ring_deinit(Ring *ring)
+{
+	free(ring->slots);
+	ring->slots = NULL;
+}
+
+void*
+ring_acquire_write(Ring *ring)
+{
+	const size_t head = ring->head;
+	unsigned iter = 0;
+
+	while (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= ring->nslots) {
+		if (*ring->cancel) return NULL;
+		backoff(&iter);
+	}
+
+	return ring->slots + (head & (ring->nslots - 1)) * ring->slot_size;
+}
+
+void
+ring_commit_write(Ring *ring)
+{
+	__atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+void*
+ring_acquire_read(Ring *ring)
+{
+	const size_t tail = ring->tail;
+	unsigned iter = 0;
+
+	while (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail) {
+		if (*ring->cancel) return NULL;
+		backoff(&iter);
+	}
+
+	return ring->slots + (tail & (ring->nslots - 1)) * ring->slot_size;
+}
+
+void
+ring_commit_read(Ring *ring)
+{
+	__atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+}
+
+/* Static functions {{{ */
+/* Spin for a while, then start yielding the CPU, then start sleeping */
+static void
+backoff(unsigned *iter)
+{
+	const struct timespec ts = {0, SLEEP_NS};
+
+	if (*iter < SPIN_COUNT) {
+		(*iter)++;
+	} else if (*iter < 2*SPIN_COUNT) {
+		(*iter)++;
+		sched_yield();
+	} else {
+		nanosleep(&ts, NULL);
+	}
+}
+/* }}} */
@@ -0,0 +1,75 @@
+/**
+ * Lock-free single-producer/single-consumer ring buffer of fixed-size slots,
+ * used to connect the stages of the pipelined demodulator
+ */
+#ifndef ring_h
+#define ring_h
+
+#include <stddef.h>
+
+#define CACHELINE_SIZE 64
+
+typedef struct {
+	unsigned char *slots;
+	size_t slot_size;
+	size_t nslots;
+	const volatile int *cancel;
+
+	/* Producer and consumer indices live on separate cache lines, so that
+	 * the two threads don't keep invalidating each other's copy */
+	size_t head __attribute__((aligned(CACHELINE_SIZE)));
+	size_t tail __attribute__((aligned(CACHELINE_SIZE)));
+} Ring;
+
+/**
+ * Initialize a ring buffer
+ *
+ * @param ring ring to initialize
+ * @param nslots number of slots, must be a power of 2
+ * @param slot_size size of each slot in bytes
+ * @param cancel pointer to a flag that, when set, aborts any blocking
+ *        operation on the ring
+ * @return 0 on success, 1 on failure
+ */
+int ring_init(Ring *ring, size_t nslots, size_t slot_size, const volatile int *cancel);
+
+/**
+ * Deinitialize a ring buffer
+ *
+ * @param ring ring to deinitialize
+ */
+void ring_deinit(Ring *ring);
+
+/**
+ * Get the next slot to write to, waiting for one to be available if the ring
+ * is full. Must only be called by the producer
+ *
+ * @param ring ring to write to
+ * @return pointer to the slot, or NULL if the wait was cancelled
+ */
+void* ring_acquire_write(Ring *ring);
+
+/**
+ * Publish the slot returned by ring_acquire_write() to the consumer
+ *
+ * @param ring ring to commit to
+ */
+void ring_commit_write(Ring *ring);
+
+/**
+ * Get the next slot to read from, waiting for one to be available if the ring
+ * is empty. Must only be called by the consumer
+ *
+ * @param ring ring to read from
+ * @return pointer to the slot, or NULL if the wait was cancelled
+ */
+void* ring_acquire_read(Ring *ring);
+
+/**
+ * Release the slot returned by ring_acquire_read() back to the producer
+ *
+ * @param ring ring to release the slot to
+ */
+void ring_commit_read(Ring *ring);
+
+#endif
@@ -0,0 +1,274 @@
+#include <complex.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "source.h"
+#include "utils.h"
+#include "wavfile.h"
+
+/* Size of the sliding window mapped at any given time. Mapping the whole file
+ * at once would not work on 32-bit targets for multi-GB recordings */
+#define MMAP_WINDOW (64 * 1024 * 1024)
+
+static Source* source_new(FILE *fd, int bps);
+static int remap(Source *src);
+static const uint8_t* map_read(Source *src, size_t *count);
+static const uint8_t* net_read_samples(Source *src, size_t *count);
+
+Source*
+source_open(FILE *fd, int bps)
+{
+	Source *src;
+	struct stat st;
+	long offset;
+
+	if (!(src = source_new(fd, bps))) return NULL;
+
+	/* Only regular files can be mapped, everything else goes through stdio */
+	offset = ftell(fd);
+	if (offset < 0 || fstat(fileno(fd), &st) || !S_ISREG(st.st_mode)) return src;
+
+	src->offset = offset;
+	src->size = st.st_size;
+	remap(src);     /* On failure, map == NULL: fall back to buffered reads */
+
+	return src;
+}
+
+Source*
+source_open_range(FILE *fd, int bps, uint64_t start, uint64_t end)
+{
+	Source *src;
+
+	if (!(src = source_new(fd, bps))) return NULL;
+
+	src->offset = start;
+	src->size = end;
+	if (remap(src)) {
+		free(src);
+		return NULL;
+	}
+
+	return src;
+}
+
+Source*
+source_open_net(NetSource *net, int bps)
+{
+	Source *src;
+
+	if (!(src = source_new(NULL, bps))) return NULL;
+	src->net = net;
+
+	return src;
+}
+
+const float complex*
+source_read(Source *src, float complex *buf, size_t *count)
+{
+	const uint8_t *ptr;
+
+	/* Network backend */
+	if (src->net) {
+		if ((ptr = net_read_samples(src, count))) wav_convert(buf, ptr, *count, src->bps);
+		return buf;
+	}
+
+	/* Buffered backend */
+	if (!src->map) {
+		*count = wav_read_block(buf, *count, src->bps, src->fd);
+		src->offset += *count * src->sample_size;
+		return buf;
+	}
+
+	if (!(ptr = map_read(src, count))) return buf;
+
+	/* Floats can be handed to the demodulator straight from the mapping, as
+	 * long as they're properly aligned */
+	if (src->bps == 32 && !((uintptr_t)ptr % sizeof(float))) {
+		return (const float complex*)ptr;
+	}
+
+	wav_convert(buf, ptr, *count, src->bps);
+	return buf;
+}
+
+const int16_t*
+source_read_s16(Source *src, int16_t *buf, size_t *count)
+{
+	const uint8_t *ptr;
+
+	if (src->bps != 8 && src->bps != 16) {
+		*count = 0;
+		return buf;
+	}
+
+	/* Network backend */
+	if (src->net) {
+		if ((ptr = net_read_samples(src, count))) wav_convert_s16(buf, ptr, *count, src->bps);
+		return buf;
+	}
+
+	/* Buffered backend */
+	if (!src->map) {
+		*count = wav_read_block_s16(buf, *count, src->bps, src->fd);
+		src->offset += *count * src->sample_size;
+		return buf;
+	}
+
+	if (!(ptr = map_read(src, count))) return buf;
+
+	/* Same as source_read(), but for 16-bit integers */
+	if (src->bps == 16 && !((uintptr_t)ptr % sizeof(int16_t))) {
+		return (const int16_t*)ptr;
+	}
+
+	wav_convert_s16(buf, ptr, *count, src->bps);
+	return buf;
+}
+
+uint64_t
+source_tell(const Source *src)
+{
+	return src->offset;
+}
+
+int
+source_backlog(const Source *src, uint64_t *bytes)
+{
+	struct stat st;
+	int fd, avail;
+
+	/* Files are read as fast as possible, and the size of the next datagram
+	 * is all FIONREAD would tell about a UDP socket */
+	if (src->map || (src->net && src->net->udp)) return 1;
+
+	fd = src->net ? src->net->fd : fileno(src->fd);
+	if (fstat(fd, &st) || !(S_ISFIFO(st.st_mode) || S_ISSOCK(st.st_mode))) return 1;
+	if (ioctl(fd, FIONREAD, &avail)) return 1;
+
+	*bytes = avail;
+	return 0;
+}
+
+void
+source_close(Source *src)
+{
+	if (src->map) munmap((void*)src->map, src->map_end - src->map_start);
+	if (src->net) net_close(src->net);
+	free(src->net_buf);
+	free(src);
+}
+
+/* Static functions {{{ */
+static Source*
+source_new(FILE *fd, int bps)
+{
+	Source *src;
+
+	if (bps != 8 && bps != 16 && bps != 32) return NULL;
+	if (!(src = calloc(1, sizeof(*src)))) return NULL;
+
+	src->fd = fd;
+	src->bps = bps;
+	src->sample_size = 2*bps/8;
+	src->map = NULL;
+	src->net = NULL;
+	src->net_buf = NULL;
+
+	return src;
+}
+
+/**
+ * Map the window of the file starting at the page containing the current read
+ * offset
+ *
+ * @return 0 on success, 1 on EOF or failure
+ */
+static int
+remap(Source *src)
+{
+	const uint64_t page_size = sysconf(_SC_PAGESIZE);
+	uint64_t start, end;
+	void *map;
+
+	if (src->map) {
+		munmap((void*)src->map, src->map_end - src->map_start);
+		src->map = NULL;
+	}
+
+	start = src->offset - src->offset % page_size;
+	end = MIN(src->size, start + MMAP_WINDOW);
+	if (end - src->offset < src->sample_size) return 1;
+
+	map = mmap(NULL, end - start, PROT_READ, MAP_PRIVATE, fileno(src->fd), start);
+	if (map == MAP_FAILED) return 1;
+
+	madvise(map, end - start, MADV_SEQUENTIAL);
+	madvise(map, end - start, MADV_WILLNEED);
+
+	src->map = map;
+	src->map_start = start;
+	src->map_end = end;
+
+	return 0;
+}
+
+/**
+ * Consume up to *count samples from the current mapping window, sliding it
+ * forward if necessary
+ *
+ * @return pointer to the samples in the mapping, NULL on EOF or failure
+ */
+static const uint8_t*
+map_read(Source *src, size_t *count)
+{
+	const uint8_t *ptr;
+	size_t avail, n;
+
+	/* Slide the window forward when it doesn't contain a full sample anymore */
+	if (src->map_end - src->offset < src->sample_size) {
+		if (remap(src)) {
+			*count = 0;
+			return NULL;
+		}
+	}
+
+	avail = (src->map_end - src->offset) / src->sample_size;
+	n = MIN(*count, avail);
+	ptr = src->map + (src->offset - src->map_start);
+	src->offset += n * src->sample_size;
+	*count = n;
+
+	return ptr;
+}
+
+/**
+ * Read up to *count samples from the network into the scratch buffer. Any
+ * trailing partial sample is dropped, which can only happen at end of stream
+ *
+ * @return pointer to the raw samples, NULL on end of stream or failure
+ */
+static const uint8_t*
+net_read_samples(Source *src, size_t *count)
+{
+	const size_t len = *count * src->sample_size;
+	uint8_t *tmp;
+
+	if (src->net_buf_size < len) {
+		if (!(tmp = realloc(src->net_buf, len))) {
+			*count = 0;
+			return NULL;
+		}
+		src->net_buf = tmp;
+		src->net_buf_size = len;
+	}
+
+	*count = net_read(src->net, src->net_buf, len) / src->sample_size;
+	src->offset += *count * src->sample_size;
+
+	return *count ? src->net_buf : NULL;
+}
+/* }}} */
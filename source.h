@@ -0,0 +1,117 @@
+/**
+ * Sample source abstraction: reads I/Q samples either from a memory-mapped
+ * file (zero-copy where possible), through buffered stdio for pipes/stdin, or
+ * from a network stream
+ */
+#ifndef source_h
+#define source_h
+
+#include <complex.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "net.h"
+
+typedef struct {
+	FILE *fd;
+	int bps;
+	size_t sample_size;         /* Bytes per I/Q pair */
+
+	/* mmap backend, map == NULL when using buffered reads */
+	const uint8_t *map;
+	uint64_t map_start, map_end;    /* Mapped byte range, relative to file start */
+	uint64_t offset;                /* Current read position in bytes */
+	uint64_t size;                  /* File size in bytes */
+
+	/* Network backend, NULL when reading from a file */
+	NetSource *net;
+	uint8_t *net_buf;               /* Raw bytes awaiting conversion */
+	size_t net_buf_size;
+} Source;
+
+/**
+ * Create a sample source reading from a file descriptor. If the descriptor
+ * refers to a regular file it will be memory-mapped, otherwise (stdin, pipes,
+ * fifos) samples are read through stdio
+ *
+ * @param fd file to read from, positioned at the start of the raw samples. Must
+ *        be kept open until the source is closed
+ * @param bps bits per sample
+ * @return source object on success, NULL on failure
+ */
+Source* source_open(FILE *fd, int bps);
+
+/**
+ * Create a memory-mapped sample source reading a byte range of a regular file.
+ * Multiple sources can read from the same file concurrently
+ *
+ * @param fd file to read from. Must be kept open until the source is closed
+ * @param bps bits per sample
+ * @param start offset of the first byte to read
+ * @param end offset of the byte after the last one to read
+ * @return source object on success, NULL on failure or if the file cannot be
+ *         mapped
+ */
+Source* source_open_range(FILE *fd, int bps, uint64_t start, uint64_t end);
+
+/**
+ * Create a sample source reading from a network stream
+ *
+ * @param net network source to read from. Ownership is transferred to the
+ *        sample source, and it will be closed together with it
+ * @param bps bits per sample
+ * @return source object on success, NULL on failure
+ */
+Source* source_open_net(NetSource *net, int bps);
+
+/**
+ * Read a block of samples from a source
+ *
+ * @param src source to read from
+ * @param buf scratch buffer, must be able to hold at least *count samples
+ * @param count pointer to the number of samples to read, updated with the
+ *        number of samples actually read (0 on EOF)
+ * @return pointer to the samples read. This is either buf, or a pointer
+ *         directly into the mapped file when no conversion is necessary
+ */
+const float complex* source_read(Source *src, float complex *buf, size_t *count);
+
+/**
+ * Read a block of samples from a source as interleaved 16-bit I/Q, for the
+ * fixed-point demodulator. Only supported for 8 and 16 bits per sample
+ *
+ * @param src source to read from
+ * @param buf scratch buffer, must be able to hold at least 2 * *count values
+ * @param count pointer to the number of samples to read, updated with the
+ *        number of samples actually read (0 on EOF)
+ * @return pointer to the samples read, see source_read()
+ */
+const int16_t* source_read_s16(Source *src, int16_t *buf, size_t *count);
+
+/**
+ * Get the current read position of a source
+ *
+ * @param src source to query
+ * @return number of bytes read from the start of the file
+ */
+uint64_t source_tell(const Source *src);
+
+/**
+ * Get the amount of data waiting to be read from a pipe or a TCP stream, i.e.
+ * how far behind the input the reader is. Data already buffered by stdio is
+ * not included
+ *
+ * @param src source to query
+ * @param bytes filled with the number of bytes waiting
+ * @return 0 on success, 1 if the source is not a pipe or a TCP stream
+ */
+int source_backlog(const Source *src, uint64_t *bytes);
+
+/**
+ * Close a sample source. The underlying file descriptor is left open, while
+ * network sources are closed
+ *
+ * @param src source to close
+ */
+void source_close(Source *src);
+
+#endif
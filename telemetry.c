@@ -0,0 +1,65 @@
+#include <string.h>
+#include "telemetry.h"
+#include "utils.h"
+
+#define TELEMETRY_FRESH 0x4
+
+void
+telemetry_init(Telemetry *tm)
+{
+	memset(tm, 0, sizeof(*tm));
+	tm->back = 0;
+	tm->middle = 1;
+	tm->front = 2;
+}
+
+int
+telemetry_push_symbols(Telemetry *tm, const float complex *symbols, size_t count)
+{
+	size_t i, idx;
+
+	tm->pending += count;
+
+	/* Same conversion as the 8-bit soft symbols written out */
+	idx = tm->symbols_idx;
+	for (i=count - MIN(count, TELEMETRY_SYMBOLS); i<count; i++) {
+		tm->symbols[idx++] = MAX(-127, MIN(127, crealf(symbols[i])/2));
+		tm->symbols[idx++] = MAX(-127, MIN(127, cimagf(symbols[i])/2));
+		if (idx >= LEN(tm->symbols)) idx = 0;
+	}
+	tm->symbols_idx = idx;
+
+	return tm->pending >= TELEMETRY_INTERVAL;
+}
+
+TelemetryData*
+telemetry_begin_write(Telemetry *tm)
+{
+	return &tm->buf[tm->back];
+}
+
+void
+telemetry_publish(Telemetry *tm)
+{
+	TelemetryData *data = &tm->buf[tm->back];
+	const size_t split = LEN(tm->symbols) - tm->symbols_idx;
+
+	/* Unroll the symbol ring, oldest first */
+	memcpy(data->symbols, tm->symbols + tm->symbols_idx, split);
+	memcpy(data->symbols + split, tm->symbols, tm->symbols_idx);
+	tm->pending = 0;
+
+	/* Hand the filled buffer over, and take the previous one back to write
+	 * the next snapshot into. The reader never holds the middle buffer */
+	tm->back = __atomic_exchange_n(&tm->middle, tm->back | TELEMETRY_FRESH, __ATOMIC_ACQ_REL) & ~TELEMETRY_FRESH;
+}
+
+const TelemetryData*
+telemetry_read(Telemetry *tm)
+{
+	if (__atomic_load_n(&tm->middle, __ATOMIC_RELAXED) & TELEMETRY_FRESH) {
+		tm->front = __atomic_exchange_n(&tm->middle, tm->front, __ATOMIC_ACQ_REL) & ~TELEMETRY_FRESH;
+	}
+
+	return &tm->buf[tm->front];
+}
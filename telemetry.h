@@ -0,0 +1,96 @@
+/**
+ * Snapshot of the demodulator state, published by the thread running the
+ * demodulator for the status display. Triple-buffered: the writer always has a
+ * buffer of its own to fill, and the reader always gets the latest complete
+ * one, so neither ever waits for the other and reads are never torn
+ */
+#ifndef telemetry_h
+#define telemetry_h
+
+#include <complex.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "net.h"
+#include "profile.h"
+#include "ring.h"
+
+#define TELEMETRY_SYMBOLS 512       /* Symbols kept for the constellation */
+#define TELEMETRY_INTERVAL 1024     /* Symbols between two snapshots */
+
+typedef struct {
+	float carrier_freq;             /* As returned by pll_get_freq() */
+	float symbol_freq;              /* As returned by mm_omega() */
+	float gain;                     /* As returned by demod_get_gain() */
+	int locked;                     /* As returned by pll_get_locked() */
+	uint64_t offset;                /* Input position, as returned by source_tell() */
+	NetStats net;                   /* As returned by net_get_stats(), zero for other sources */
+#ifdef ENABLE_PROFILING
+	Profile prof;                   /* As returned by prof_copy() */
+#endif
+	int8_t symbols[2*TELEMETRY_SYMBOLS];    /* Latest soft symbols, oldest first */
+} __attribute__((aligned(CACHELINE_SIZE))) TelemetryData;
+
+typedef struct {
+	TelemetryData buf[3];
+
+	/* Writer side: buffer being filled, and the latest symbols */
+	int back __attribute__((aligned(CACHELINE_SIZE)));
+	int8_t symbols[2*TELEMETRY_SYMBOLS];
+	size_t symbols_idx;
+	size_t pending;                 /* Symbols since the last snapshot */
+
+	/* Index of the buffer in between, with TELEMETRY_FRESH set if it holds a
+	 * snapshot the reader hasn't seen yet */
+	int middle __attribute__((aligned(CACHELINE_SIZE)));
+
+	/* Reader side: buffer being read */
+	int front __attribute__((aligned(CACHELINE_SIZE)));
+} Telemetry;
+
+/**
+ * Initialize a telemetry snapshot
+ *
+ * @param tm snapshot to initialize
+ */
+void telemetry_init(Telemetry *tm);
+
+/**
+ * Record the symbols produced by the demodulator. Only the last
+ * TELEMETRY_SYMBOLS of each call are kept. Must only be called by the writer
+ *
+ * @param tm snapshot to update
+ * @param symbols demodulated symbols
+ * @param count number of symbols
+ * @return 1 if TELEMETRY_INTERVAL symbols have been produced since the last
+ *         snapshot was published, 0 otherwise
+ */
+int telemetry_push_symbols(Telemetry *tm, const float complex *symbols, size_t count);
+
+/**
+ * Get the buffer to fill in before calling telemetry_publish(). It holds an
+ * older snapshot, so every field must be written. Must only be called by the
+ * writer
+ *
+ * @param tm snapshot to write to
+ * @return buffer to fill in
+ */
+TelemetryData* telemetry_begin_write(Telemetry *tm);
+
+/**
+ * Publish the buffer returned by telemetry_begin_write(), together with the
+ * latest symbols, to the reader
+ *
+ * @param tm snapshot to publish
+ */
+void telemetry_publish(Telemetry *tm);
+
+/**
+ * Get the latest published snapshot. The returned buffer stays valid and
+ * unchanged until the next call. Must only be called by the reader
+ *
+ * @param tm snapshot to read
+ * @return latest snapshot
+ */
+const TelemetryData* telemetry_read(Telemetry *tm);
+
+#endif
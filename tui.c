@@ -1,15 +1,54 @@
 #include <assert.h>
+#include <limits.h>
 #include <locale.h>
 #include <math.h>
 #include <ncurses.h>
 #include <stdarg.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
 #include "tui.h"
 #include "utils.h"
 
-/* Saved for when we want to wait indefinitely for user input */
-static unsigned _upd_interval;
+/* First row below the status windows that are always shown, and rows taken by
+ * each of the optional ones stacked under them */
+#define OPT_PANEL_ROW 12
+#define OPT_PANEL_ROWS 3
+
+/* Longest refresh interval when backing off, in ms */
+#define MAX_UPD_INTERVAL 1000
+
+/* Requested refresh interval, and the one currently in use */
+static unsigned _upd_interval, _cur_interval;
+
+/* Position of the optional windows, and first row of the log window below them */
+static int _live_row, _infowin_min_row;
+#ifdef ENABLE_PROFILING
+static int _profile_row;
+#endif
+
+/* What each panel currently shows, so that unchanged panels aren't redrawn.
+ * Cleared whenever the windows are redrawn from scratch */
+static struct {
+	int locked;
+	char pll[64], filein[64], dataout[16], live[64];
+#ifdef ENABLE_PROFILING
+	char profile[128];
+#endif
+	char iq[CONSTELL_MAX/2][CONSTELL_MAX];   /* Glyph in each cell, 0 if unknown */
+} _shown;
+
+/* Constellation density histogram, averaged over the last few frames so that
+ * the cells don't flicker between glyphs on noise. Fixed point, HIST_ONE
+ * per point */
+#define HIST_ONE 16
+#define HIST_SHIFT 2
+static uint32_t _hist[CONSTELL_MAX/2][CONSTELL_MAX];
+
+/* Constellation cell glyphs by increasing density, and the fraction of the
+ * points (1/n) a cell must hold for each of them, with a minimum of one */
+static const char _density_glyphs[] = ".-+#";
+static const unsigned _density_fractions[] = { UINT_MAX, 256, 128, 64 };
 
 enum {
 	PAIR_DEF = 1,
@@ -18,6 +57,7 @@ enum {
 };
 
 static void print_banner(WINDOW *win);
+static int unchanged(char *shown, size_t size, const char *str);
 static void iq_draw_quadrants(WINDOW *win);
 static void windows_init(int rows, int col);
 
@@ -25,15 +65,18 @@ static void windows_init(int rows, int col);
 struct {
 	WINDOW *banner_top;
 	WINDOW *iq;
-	WINDOW *pll, *filein, *dataout;
+	WINDOW *pll, *filein, *dataout, *live;
+#ifdef ENABLE_PROFILING
+	WINDOW *profile;
+#endif
 	WINDOW *infowin;
 } tui;
 
 /* Initialize the ncurses tui */
 void
-tui_init(unsigned upd_interval)
+tui_init(unsigned upd_interval, int live)
 {
-	int rows, cols;
+	int rows, cols, row;
 	setlocale(LC_ALL, "");
 
 	initscr();
@@ -48,7 +91,16 @@ tui_init(unsigned upd_interval)
 	init_pair(PAIR_GREEN_DEF, COLOR_GREEN, -1);
 
 	getmaxyx(stdscr, rows, cols);
-	_upd_interval = upd_interval;
+	_upd_interval = _cur_interval = upd_interval;
+
+	row = OPT_PANEL_ROW;
+	_live_row = live ? row : -1;
+	if (live) row += OPT_PANEL_ROWS;
+#ifdef ENABLE_PROFILING
+	_profile_row = row;
+	row += OPT_PANEL_ROWS;
+#endif
+	_infowin_min_row = row;
 
 	windows_init(rows, cols);
 	tui_update_pll(0, 0, 0, 1);
@@ -81,21 +133,38 @@ tui_handle_resize()
 	mvwin(tui.filein, 6, iq_size+2);
 	wresize(tui.dataout, 2, nc - iq_size - 2);
 	mvwin(tui.dataout, 9, iq_size+2);
+	if (tui.live) {
+		wresize(tui.live, 2, nc - iq_size - 2);
+		mvwin(tui.live, _live_row, iq_size+2);
+	}
+#ifdef ENABLE_PROFILING
+	wresize(tui.profile, 2, nc - iq_size - 2);
+	mvwin(tui.profile, _profile_row, iq_size+2);
+#endif
 	wresize(tui.infowin, nr-iq_size/2-4, nc);
-	mvwin(tui.infowin, MAX(12, 2+iq_size/2+1), 0);
+	mvwin(tui.infowin, MAX(_infowin_min_row, 2+iq_size/2+1), 0);
+
+	/* Everything has to be drawn again */
+	memset(&_shown, 0, sizeof(_shown));
+	memset(_hist, 0, sizeof(_hist));
 
 	print_banner(tui.banner_top);
+	werase(tui.iq);
 	iq_draw_quadrants(tui.iq);
 	wrefresh(tui.iq);
 }
 
 /* Get user input, return 1 if an abort was requested, 0 otherwise. This also
  * doubles as a throttling for the refresh rate, since wgetch() blocks for
- * upd_interval milliseconds before returning if no key is pressed */
+ * upd_interval milliseconds before returning if no key is pressed. Panels are
+ * only queued for output when updated, and are all sent to the terminal here
+ * in a single update */
 int
 tui_process_input()
 {
 	int ch;
+
+	doupdate();
 	ch = wgetch(tui.infowin);
 
 	switch(ch) {
@@ -135,12 +204,32 @@ tui_print_info(const char *msg, ...)
 	return 0;
 }
 
+/* Halve the refresh rate while the demodulator is behind real time, up to
+ * MAX_UPD_INTERVAL, then bring it back up once it has caught up */
+void
+tui_set_behind(int behind)
+{
+	unsigned interval;
+
+	interval = behind ? MIN(MAX_UPD_INTERVAL, 2*_cur_interval) : MAX(_upd_interval, _cur_interval/2);
+	if (interval == _cur_interval) return;
+
+	_cur_interval = interval;
+	wtimeout(tui.infowin, _cur_interval);
+}
+
 /* Update the PLL info displayed */
 void
 tui_update_pll(float freq, float rate, int islocked, float gain)
 {
+	char line[sizeof(_shown.pll)];
+
 	assert(tui.pll);
 
+	snprintf(line, sizeof(line), "%.3f\t%+7.1f Hz\t%7.1f Hz\n", gain, freq, rate);
+	if (unchanged(_shown.pll, sizeof(_shown.pll), line) && islocked == _shown.locked) return;
+	_shown.locked = islocked;
+
 	werase(tui.pll);
 	wmove(tui.pll, 0, 0);
 	wattrset(tui.pll, A_BOLD);
@@ -155,49 +244,53 @@ tui_update_pll(float freq, float rate, int islocked, float gain)
 	wattrset(tui.pll, COLOR_PAIR(PAIR_DEF));
 	wattroff(tui.pll, A_BOLD);
 	wprintw(tui.pll, "Gain\tCarrier freq\tSymbol rate\n");
-	wprintw(tui.pll, "%.3f\t%+7.1f Hz\t%7.1f Hz\n", gain, freq, rate);
-	wrefresh(tui.pll);
+	wprintw(tui.pll, "%s", line);
+	wnoutrefresh(tui.pll);
 }
 
-/* Draw an indicative constellation plot, not an accurate one, but still
- * indicative of the signal quality (*dots should be mutexed for this to be
- * accurate, since it comes directly from the decoding thread's memory domain) */
+/* Draw an indicative constellation plot: the points are binned into one
+ * histogram cell per character, and each cell shows how dense it has been
+ * over the last few frames. Only the cells whose glyph changed are redrawn,
+ * and the axes are left alone */
 void
 tui_draw_constellation(const int8_t *dots, unsigned count)
 {
-	int8_t x, y;
-	int nr, nc;
-	unsigned i;
-	int prev;
+	uint32_t hist[CONSTELL_MAX/2][CONSTELL_MAX];
+	int nr, nc, row, col, level;
+	unsigned i, npoints;
+	char glyph;
 
 	assert(tui.iq);
 
 	getmaxyx(tui.iq, nr, nc);
+	nr = MIN(nr, CONSTELL_MAX/2);
+	nc = MIN(nc, CONSTELL_MAX);
+
+	memset(hist, 0, sizeof(hist));
+	for (i=0; i+1<count; i+=2) {
+		row = nr/2 - dots[i+1]*nr/255;
+		col = nc/2 + dots[i]*nc/255;
+		if (row >= 0 && row < nr && col >= 0 && col < nc) hist[row][col]++;
+	}
 
-	werase(tui.iq);
-	for (i=0; i<count; i++) {
-		x = dots[i++]*nc/255;
-		y = dots[i]*nr/255;
-
-		prev = mvwinch(tui.iq, nr/2-y, x+nc/2);
-		switch(prev) {
-		case '.':
-			waddch(tui.iq, '-');
-			break;
-		case '-':
-			waddch(tui.iq, '+');
-			break;
-		case '+':
-			waddch(tui.iq, '#');
-			break;
-		case '#':
-			break;
-		default:
-			waddch(tui.iq, '.');
-			break;
+	npoints = count/2;
+	for (row=0; row<nr; row++) {
+		for (col=0; col<nc; col++) {
+			if (row == nr/2 || col == nc/2) continue;
+
+			_hist[row][col] += (int32_t)(hist[row][col]*HIST_ONE - _hist[row][col]) >> HIST_SHIFT;
+			for (level=0; level<(int)LEN(_density_fractions)
+			              && _hist[row][col] >= MAX(1, npoints/_density_fractions[level]) * HIST_ONE; level++)
+				;
+			glyph = level ? _density_glyphs[level-1] : ' ';
+
+			if (_shown.iq[row][col] != glyph) {
+				mvwaddch(tui.iq, row, col, glyph);
+				_shown.iq[row][col] = glyph;
+			}
 		}
 	}
-	iq_draw_quadrants(tui.iq);
+	wnoutrefresh(tui.iq);
 }
 
 /* Update the input file info */
@@ -207,6 +300,7 @@ tui_update_file_in(unsigned samplerate, uint64_t done, uint64_t total)
 	float perc;
 	char total_duration[sizeof("HH:MM:SS")];
 	char done_duration[sizeof("HH:MM:SS")];
+	char line[sizeof(_shown.filein)];
 
 	assert(tui.filein);
 
@@ -218,15 +312,18 @@ tui_update_file_in(unsigned samplerate, uint64_t done, uint64_t total)
 	seconds_to_str(total, total_duration);
 	seconds_to_str(done, done_duration);
 
+	snprintf(line, sizeof(line), "%s/%s (%.1f%%)", done_duration, total_duration, perc);
+	if (unchanged(_shown.filein, sizeof(_shown.filein), line)) return;
+
 	werase(tui.filein);
 
 	wmove(tui.filein, 0, 0);
 	wattrset(tui.filein, A_BOLD);
 	wprintw(tui.filein, "Data in\n");
 	wattroff(tui.filein, A_BOLD);
-	wprintw(tui.filein, "%s/%s (%.1f%%)", done_duration, total_duration, perc);
+	wprintw(tui.filein, "%s", line);
 
-	wrefresh(tui.filein);
+	wnoutrefresh(tui.filein);
 }
 
 /* Update the data out info */
@@ -238,14 +335,57 @@ tui_update_data_out(unsigned nbytes)
 
 	assert(tui.dataout);
 
+	if (unchanged(_shown.dataout, sizeof(_shown.dataout), humansize)) return;
+
 	werase(tui.dataout);
 	wattrset(tui.dataout, A_BOLD);
 	mvwprintw(tui.dataout, 0, 0, "Data out\n");
 	wattroff(tui.dataout, A_BOLD);
 	wprintw(tui.dataout, "%sB", humansize);
-	wrefresh(tui.dataout);
+	wnoutrefresh(tui.dataout);
 }
 
+/* Update the real-time info, backlog < 0 if unknown */
+void
+tui_update_live(float rtf, float backlog)
+{
+	char line[sizeof(_shown.live)];
+
+	assert(tui.live);
+
+	if (backlog < 0) {
+		snprintf(line, sizeof(line), "%.2f RTF", rtf);
+	} else {
+		snprintf(line, sizeof(line), "%.2f RTF, %.1fs backlog", rtf, backlog);
+	}
+	if (unchanged(_shown.live, sizeof(_shown.live), line)) return;
+
+	werase(tui.live);
+	wattrset(tui.live, A_BOLD);
+	mvwprintw(tui.live, 0, 0, "Real time\n");
+	wattroff(tui.live, A_BOLD);
+	wprintw(tui.live, "%s", line);
+	wnoutrefresh(tui.live);
+}
+
+#ifdef ENABLE_PROFILING
+/* Update the profiling info */
+void
+tui_update_profile(const char *summary)
+{
+	assert(tui.profile);
+
+	if (unchanged(_shown.profile, sizeof(_shown.profile), summary)) return;
+
+	werase(tui.profile);
+	wattrset(tui.profile, A_BOLD);
+	mvwprintw(tui.profile, 0, 0, "Profile\n");
+	wattroff(tui.profile, A_BOLD);
+	wprintw(tui.profile, "%s", summary);
+	wnoutrefresh(tui.profile);
+}
+#endif
+
 /* Wait indefinitely for user input */
 int
 tui_wait_for_user_input()
@@ -254,7 +394,7 @@ tui_wait_for_user_input()
 
 	wtimeout(tui.infowin, -1);
 	ret = wgetch(tui.infowin);
-	wtimeout(tui.infowin, _upd_interval);
+	wtimeout(tui.infowin, _cur_interval);
 
 	return ret;
 }
@@ -267,12 +407,28 @@ tui_deinit()
 	delwin(tui.pll);
 	delwin(tui.filein);
 	delwin(tui.dataout);
+	if (tui.live) delwin(tui.live);
+#ifdef ENABLE_PROFILING
+	delwin(tui.profile);
+#endif
 	delwin(tui.infowin);
 	delwin(tui.banner_top);
 	endwin();
 }
 
 /* Static functions {{{ */
+/* Check whether a panel already shows a string, and remember it if not. Only
+ * the first size - 1 characters are kept and compared, so that longer strings
+ * are still cached */
+static int
+unchanged(char *shown, size_t size, const char *str)
+{
+	if (!strncmp(shown, str, size - 1)) return 1;
+
+	snprintf(shown, size, "%s", str);
+	return 0;
+}
+
 /* Print the top banner */
 void
 print_banner(WINDOW *win)
@@ -294,8 +450,12 @@ windows_init(int rows, int cols)
 	tui.pll = newwin(3, cols-iq_size-2, 2, iq_size+2);
 	tui.filein = newwin(2, cols-iq_size-2, 6, iq_size+2);
 	tui.dataout = newwin(2, cols-iq_size-2, 9, iq_size+2);
+	tui.live = _live_row >= 0 ? newwin(2, cols-iq_size-2, _live_row, iq_size+2) : NULL;
+#ifdef ENABLE_PROFILING
+	tui.profile = newwin(2, cols-iq_size-2, _profile_row, iq_size+2);
+#endif
 	tui.infowin = newwin(rows-iq_size/2-4, cols,
-	                     MAX(12, 2+iq_size/2+1), 0);
+	                     MAX(_infowin_min_row, 2+iq_size/2+1), 0);
 
 	scrollok(tui.infowin, TRUE);
 	wtimeout(tui.infowin, _upd_interval);
@@ -8,17 +8,22 @@
 
 #define CONSTELL_MAX 31
 
-void tui_init(unsigned upd_interval);
+void tui_init(unsigned upd_interval, int live);
 void tui_deinit(void);
 void tui_handle_resize(void);
 
 int  tui_process_input(void);
+void tui_set_behind(int behind);
 
 int  tui_print_info(const char *msg, ...);
 void tui_update_pll(float freq, float rate, int islocked, float gain);
 void tui_draw_constellation(const int8_t *dots, unsigned count);
 void tui_update_file_in(unsigned rate, uint64_t done, uint64_t duration);
 void tui_update_data_out(unsigned nbytes);
+void tui_update_live(float rtf, float backlog);
+#ifdef ENABLE_PROFILING
+void tui_update_profile(const char *summary);
+#endif
 int  tui_wait_for_user_input(void);
 
 #endif
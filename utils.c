@@ -91,6 +91,7 @@ usage(const char *pname)
 	fprintf(stderr, "Usage: %s [options] file_in\n", pname);
 	fprintf(stderr,
 	        "   -B, --batch             Disable TUI and all control characters (aka \"script-friendly mode\")\n"
+	        "   -j, --jobs <n>          Split the input file into <n> chunks demodulated in parallel (default: 1)\n"
 	        "   -m, --mode <mode>       Specify the signal modulation scheme (default: qpsk, valid modes: qpsk, oqpsk)\n"
 	        "   -o, --output <file>     Output decoded symbols to <file>\n"
 	        "   -q, --quiet             Do not print status information\n"
@@ -99,6 +100,8 @@ usage(const char *pname)
 	        "   -s, --samplerate <samp> Force the input samplerate to <samp> (default: auto)\n"
 	        "       --bps <bps>         Force the input bits per sample to <bps> (default: 16)\n"
 	        "       --stdout            Write output symbols to stdout (implies -B, -q)\n"
+	        "       --format <fmt>      Set the output encoding (default: soft8, valid formats: soft8, soft4, hard)\n"
+	        "       --header            Prefix soft8 output with a format header (always present for soft4, hard)\n"
 	        "\n"
 	        "   -h, --help              Print this help screen\n"
 	        "   -v, --version           Print version info\n"
@@ -106,8 +109,22 @@ usage(const char *pname)
 	        "Advanced options:\n"
 	        "   -b, --pll-bw <bw>       Set the PLL bandwidth to <bw> (default: 1)\n"
 	        "   -d, --freq-delta <freq> Set the maximum carrier deviation to <freq> (default: +-3.5kHz)\n"
+	        "   -D, --decim <n>         Set the number of decimate-by-2 stages before the RRC filter (default: auto)\n"
 	        "   -f, --fir-order <ord>   Set the RRC filter order to <ord> (default: 32)\n"
 	        "   -O, --oversamp <mult>   Set the interpolation factor to <mult> (default: 5)\n"
+	        "       --no-acq            Disable FFT-based carrier acquisition, sweep the carrier range instead\n"
+	        "       --fixed             Use the 16-bit fixed-point signal path (8/16-bit input only)\n"
+	        "       --cubic             Interpolate symbols with a cubic filter instead of the polyphase filter bank\n"
+	        "       --ted <ted>         Set the timing error detector (default: mm, valid detectors: mm, gardner)\n"
+	        "       --pre-agc           Normalize the input level before filtering\n"
+	        "       --two-pass          Estimate the loop parameters first, then keep the symbols from before the lock\n"
+	        "       --tune <freq>       Tune the rtl_tcp server to <freq> (default: keep the server's)\n"
+	        "       --jitter <n>        Set the UDP jitter buffer size to <n> packets (default: 32)\n"
+	        "       --live              Report the CPU time used per second of input and the input backlog\n"
+	        "       --shed              Lower the RRC filter order when falling behind a live input (implies --live)\n"
+	        "       --out-buffers <n>   Queue up to <n> output buffers for writing (default: 8)\n"
+	        "       --out-bufsize <s>   Set the size of each output buffer to <s> bytes (default: 65536)\n"
+	        "   -P, --pipeline          Run input, demodulation and output on separate threads\n"
 	        );
 }
 
@@ -2,8 +2,14 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
-#include "dsp/agc.h"
 #include "wavfile.h"
+#include "utils.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #define FILE_BUFFER_SIZE 32768
 static union {
@@ -11,7 +17,10 @@ static union {
 	int16_t words[FILE_BUFFER_SIZE/2];
 	float floats[FILE_BUFFER_SIZE/4];
 } _buffer;
-static size_t _offset;
+
+static void convert_u8(float *dst, const uint8_t *src, size_t count);
+static void convert_s16(float *dst, const int16_t *src, size_t count);
+static void widen_u8(int16_t *dst, const uint8_t *src, size_t count);
 
 struct wave_header {
 	char _riff[4];          /* Literally RIFF */
@@ -47,34 +56,196 @@ wav_parse(FILE *fd, int *samplerate, int *bps)
 	return 0;
 }
 
-int
-wav_read(float complex *dst, int bps, FILE *fd)
+size_t
+wav_read_block(float complex *dst, size_t count, int bps, FILE *fd)
 {
-	float complex tmp;
+	const size_t sample_size = 2*bps/8;
+	size_t chunk, nread, total;
+
+	if (bps != 8 && bps != 16 && bps != 32) return 0;
+
+	/* Read and convert up to a full buffer at a time */
+	for (total = 0; total < count; total += nread) {
+		chunk = MIN(count - total, sizeof(_buffer) / sample_size);
 
-	if (!_offset && !fread(&_buffer.bytes, sizeof(_buffer.bytes), 1, fd)) return 0;
+		nread = fread(_buffer.bytes, sample_size, chunk, fd);
+		wav_convert(dst + total, _buffer.bytes, nread, bps);
+
+		if (nread < chunk) return total + nread;
+	}
+
+	return total;
+}
 
+void
+wav_convert(float complex *dst, const void *src, size_t count, int bps)
+{
+	/* float complex is guaranteed to have the same layout as float[2], so all
+	 * conversions can work on the interleaved I/Q values directly */
 	switch (bps) {
 		case 8:
 			/* Unsigned byte */
-			tmp = (int)_buffer.bytes[_offset]-128 + I*((int)_buffer.bytes[_offset+1]-128);
+			convert_u8((float*)dst, src, 2*count);
 			break;
 		case 16:
 			/* Signed short */
-			tmp = _buffer.words[_offset] + I*_buffer.words[_offset+1];
+			convert_s16((float*)dst, src, 2*count);
 			break;
 		case 32:
 			/* Float */
-			tmp = _buffer.floats[_offset] + I*_buffer.floats[_offset+1];
+			memcpy(dst, src, count * sizeof(*dst));
+			break;
+		default:
+			break;
+	}
+}
+
+size_t
+wav_read_block_s16(int16_t *dst, size_t count, int bps, FILE *fd)
+{
+	const size_t sample_size = 2*bps/8;
+	size_t chunk, nread, total;
+
+	if (bps != 8 && bps != 16) return 0;
+
+	/* 16-bit samples need no conversion, read them in place */
+	if (bps == 16) return fread(dst, sample_size, count, fd);
+
+	for (total = 0; total < count; total += nread) {
+		chunk = MIN(count - total, sizeof(_buffer) / sample_size);
+
+		nread = fread(_buffer.bytes, sample_size, chunk, fd);
+		wav_convert_s16(dst + 2*total, _buffer.bytes, nread, bps);
+
+		if (nread < chunk) return total + nread;
+	}
+
+	return total;
+}
+
+void
+wav_convert_s16(int16_t *dst, const void *src, size_t count, int bps)
+{
+	switch (bps) {
+		case 8:
+			/* Unsigned byte */
+			widen_u8(dst, src, 2*count);
+			break;
+		case 16:
+			/* Signed short */
+			memcpy(dst, src, 2*count * sizeof(*dst));
 			break;
 		default:
-			return 0;
 			break;
 	}
+}
+
+/* Static functions {{{ */
+static void
+convert_u8(float *dst, const uint8_t *src, size_t count)
+{
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i bias = _mm_set1_epi16(128);
+	__m128i raw, lo, hi;
+
+	for (; i + 16 <= count; i += 16) {
+		raw = _mm_loadu_si128((const __m128i*)(src + i));
+
+		/* Widen to 16 bits and remove the DC offset */
+		lo = _mm_sub_epi16(_mm_unpacklo_epi8(raw, zero), bias);
+		hi = _mm_sub_epi16(_mm_unpackhi_epi8(raw, zero), bias);
+
+		/* Sign-extend to 32 bits and convert to float */
+		_mm_storeu_ps(dst + i,      _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16)));
+		_mm_storeu_ps(dst + i + 4,  _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16)));
+		_mm_storeu_ps(dst + i + 8,  _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16)));
+		_mm_storeu_ps(dst + i + 12, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 16)));
+	}
+#elif defined(__ARM_NEON)
+	const int16x8_t bias = vdupq_n_s16(128);
+	uint8x16_t raw;
+	int16x8_t lo, hi;
+
+	for (; i + 16 <= count; i += 16) {
+		raw = vld1q_u8(src + i);
+
+		lo = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(raw))), bias);
+		hi = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(raw))), bias);
+
+		vst1q_f32(dst + i,      vcvtq_f32_s32(vmovl_s16(vget_low_s16(lo))));
+		vst1q_f32(dst + i + 4,  vcvtq_f32_s32(vmovl_s16(vget_high_s16(lo))));
+		vst1q_f32(dst + i + 8,  vcvtq_f32_s32(vmovl_s16(vget_low_s16(hi))));
+		vst1q_f32(dst + i + 12, vcvtq_f32_s32(vmovl_s16(vget_high_s16(hi))));
+	}
+#endif
+
+	for (; i < count; i++) {
+		dst[i] = (int)src[i] - 128;
+	}
+}
+
+static void
+convert_s16(float *dst, const int16_t *src, size_t count)
+{
+	size_t i = 0;
 
-	_offset += 2;
-	if (_offset*bps/8 >= sizeof(_buffer)) _offset = 0;
+#if defined(__SSE2__)
+	__m128i raw;
 
-	*dst = tmp;
-	return 1;
+	for (; i + 8 <= count; i += 8) {
+		raw = _mm_loadu_si128((const __m128i*)(src + i));
+
+		/* Sign-extend to 32 bits and convert to float */
+		_mm_storeu_ps(dst + i,     _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(raw, raw), 16)));
+		_mm_storeu_ps(dst + i + 4, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(raw, raw), 16)));
+	}
+#elif defined(__ARM_NEON)
+	int16x8_t raw;
+
+	for (; i + 8 <= count; i += 8) {
+		raw = vld1q_s16(src + i);
+
+		vst1q_f32(dst + i,     vcvtq_f32_s32(vmovl_s16(vget_low_s16(raw))));
+		vst1q_f32(dst + i + 4, vcvtq_f32_s32(vmovl_s16(vget_high_s16(raw))));
+	}
+#endif
+
+	for (; i < count; i++) {
+		dst[i] = src[i];
+	}
+}
+static void
+widen_u8(int16_t *dst, const uint8_t *src, size_t count)
+{
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	const __m128i bias = _mm_set1_epi8(-128);
+	__m128i raw;
+
+	for (; i + 16 <= count; i += 16) {
+		/* Flip the sign bit to go from offset binary to two's complement,
+		 * then move each byte to the top half of a 16-bit word */
+		raw = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(src + i)), bias);
+		_mm_storeu_si128((__m128i*)(dst + i),     _mm_unpacklo_epi8(_mm_setzero_si128(), raw));
+		_mm_storeu_si128((__m128i*)(dst + i + 8), _mm_unpackhi_epi8(_mm_setzero_si128(), raw));
+	}
+#elif defined(__ARM_NEON)
+	const uint8x16_t bias = vdupq_n_u8(128);
+	int8x16_t raw;
+
+	for (; i + 16 <= count; i += 16) {
+		raw = vreinterpretq_s8_u8(veorq_u8(vld1q_u8(src + i), bias));
+		vst1q_s16(dst + i,     vshll_n_s8(vget_low_s8(raw), 8));
+		vst1q_s16(dst + i + 8, vshll_n_s8(vget_high_s8(raw), 8));
+	}
+#endif
+
+	for (; i < count; i++) {
+		dst[i] = ((int)src[i] - 128) * 256;
+	}
 }
+/* }}} */
@@ -2,6 +2,7 @@
 #define wavfile_h
 
 #include <complex.h>
+#include <stdint.h>
 #include <stdio.h>
 
 /**
@@ -19,15 +20,50 @@
 int wav_parse(FILE *fd, int *samplerate, int *bps);
 
 /**
- * Read a sample from the given wav file, converting it to fpcomplex_t and
- * normalizing
+ * Read a block of samples from the given wav file, converting them to
+ * float complex
  *
- * @param dst pointer to the destination sample
+ * @param dst pointer to the destination buffer
+ * @param count number of samples to read
  * @param bps bits per sample of the wav file
  * @param fd descriptor of the wav file, pointing to the next sample to read
- * @return 0 on success
- *         1 on failure
+ * @return number of samples read, less than count on EOF or failure
+ */
+size_t wav_read_block(float complex *dst, size_t count, int bps, FILE *fd);
+
+/**
+ * Convert a block of raw interleaved I/Q samples to float complex
+ *
+ * @param dst pointer to the destination buffer
+ * @param src pointer to the raw samples
+ * @param count number of I/Q pairs to convert
+ * @param bps bits per sample of the raw samples (8: unsigned, 16: signed,
+ *        32: float)
+ */
+void wav_convert(float complex *dst, const void *src, size_t count, int bps);
+
+/**
+ * Read a block of samples from the given wav file, converting them to
+ * interleaved 16-bit I/Q
+ *
+ * @param dst pointer to the destination buffer, must be able to hold 2*count
+ *        values
+ * @param count number of samples to read
+ * @param bps bits per sample of the wav file (8 or 16)
+ * @param fd descriptor of the wav file, pointing to the next sample to read
+ * @return number of samples read, less than count on EOF or failure
+ */
+size_t wav_read_block_s16(int16_t *dst, size_t count, int bps, FILE *fd);
+
+/**
+ * Convert a block of raw interleaved I/Q samples to 16-bit integers. 8-bit
+ * samples are scaled up to use the full 16-bit range
+ *
+ * @param dst pointer to the destination buffer
+ * @param src pointer to the raw samples
+ * @param count number of I/Q pairs to convert
+ * @param bps bits per sample of the raw samples (8: unsigned, 16: signed)
  */
-int wav_read(float complex *dst, int bps, FILE *fd);
+void wav_convert_s16(int16_t *dst, const void *src, size_t count, int bps);
 
 #endif
@@ -0,0 +1,216 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+#include "utils.h"
+#include "writer.h"
+
+#define WRITER_MAX_IOV 64
+
+static void* writer_thread(void *x);
+static int writev_all(int fd, struct iovec *iov, int count);
+static void submit(Writer *w);
+static double now(void);
+
+int
+writer_init(Writer *w, int fd, unsigned nbufs, size_t bufsize)
+{
+	memset(w, 0, sizeof(*w));
+	w->fd = fd;
+	w->nbufs = MAX(2, nbufs);
+	w->bufsize = MAX(1, bufsize);
+
+	if (!(w->mem = malloc(w->nbufs * w->bufsize))) return 1;
+	if (!(w->len = calloc(w->nbufs, sizeof(*w->len)))) {
+		free(w->mem);
+		return 1;
+	}
+
+	pthread_mutex_init(&w->lock, NULL);
+	pthread_cond_init(&w->queued, NULL);
+	pthread_cond_init(&w->freed, NULL);
+
+	if (pthread_create(&w->tid, NULL, writer_thread, w)) {
+		pthread_mutex_destroy(&w->lock);
+		pthread_cond_destroy(&w->queued);
+		pthread_cond_destroy(&w->freed);
+		free(w->mem);
+		free(w->len);
+		return 1;
+	}
+
+	return 0;
+}
+
+void
+writer_write(Writer *w, const void *data, size_t len)
+{
+	const uint8_t *src = data;
+	size_t chunk;
+
+	while (len) {
+		chunk = MIN(len, w->bufsize - w->fill);
+		memcpy(w->mem + (w->head % w->nbufs)*w->bufsize + w->fill, src, chunk);
+		w->fill += chunk;
+		src += chunk;
+		len -= chunk;
+
+		if (w->fill == w->bufsize) submit(w);
+	}
+}
+
+void
+writer_flush(Writer *w)
+{
+	if (w->fill) submit(w);
+}
+
+void
+writer_get_stats(Writer *w, WriterStats *stats)
+{
+	pthread_mutex_lock(&w->lock);
+	*stats = w->stats;
+	pthread_mutex_unlock(&w->lock);
+}
+
+int
+writer_deinit(Writer *w)
+{
+	writer_flush(w);
+
+	pthread_mutex_lock(&w->lock);
+	w->closing = 1;
+	pthread_cond_signal(&w->queued);
+	pthread_mutex_unlock(&w->lock);
+
+	pthread_join(w->tid, NULL);
+
+	pthread_mutex_destroy(&w->lock);
+	pthread_cond_destroy(&w->queued);
+	pthread_cond_destroy(&w->freed);
+	free(w->mem);
+	free(w->len);
+
+	return w->error;
+}
+
+/* Static functions {{{ */
+/**
+ * Writer thread: wait for buffers to be queued, and write out as many of them
+ * as possible with a single system call
+ */
+static void*
+writer_thread(void *x)
+{
+	Writer *w = (Writer*)x;
+	struct iovec iov[WRITER_MAX_IOV];
+	unsigned i, head, tail;
+	int count, error;
+	double start, elapsed;
+	size_t bytes;
+
+	pthread_mutex_lock(&w->lock);
+	for (;;) {
+		while (w->tail == w->head && !w->closing) {
+			pthread_cond_wait(&w->queued, &w->lock);
+		}
+		if (w->tail == w->head) break;
+
+		head = w->head;
+		tail = w->tail;
+		pthread_mutex_unlock(&w->lock);
+
+		/* The queued buffers are only touched by this thread until they're
+		 * released, so no need to hold the lock while writing */
+		bytes = 0;
+		for (i=tail, count=0; i != head && count < WRITER_MAX_IOV; i++, count++) {
+			iov[count].iov_base = w->mem + (i % w->nbufs)*w->bufsize;
+			iov[count].iov_len = w->len[i % w->nbufs];
+			bytes += iov[count].iov_len;
+		}
+
+		/* After a failure, keep draining the queue so that the producer
+		 * doesn't block forever, but don't bother writing anymore */
+		start = now();
+		error = w->error || writev_all(w->fd, iov, count);
+		elapsed = now() - start;
+
+		pthread_mutex_lock(&w->lock);
+		w->error = error;
+		w->tail += count;
+		w->stats.bytes += error ? 0 : bytes;
+		w->stats.write_time += elapsed;
+		pthread_cond_signal(&w->freed);
+	}
+	pthread_mutex_unlock(&w->lock);
+
+	return NULL;
+}
+
+/**
+ * Write an array of buffers in its entirety, resuming after short writes
+ *
+ * @return 0 on success, 1 on failure
+ */
+static int
+writev_all(int fd, struct iovec *iov, int count)
+{
+	ssize_t n;
+
+	while (count) {
+		n = writev(fd, iov, count);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return 1;
+
+		/* Skip over what was written */
+		for (; count && (size_t)n >= iov->iov_len; iov++, count--) {
+			n -= iov->iov_len;
+		}
+		if (count) {
+			iov->iov_base = (uint8_t*)iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Queue the buffer being filled, and wait for a free one to fill next
+ */
+static void
+submit(Writer *w)
+{
+	double start;
+
+	pthread_mutex_lock(&w->lock);
+	w->len[w->head % w->nbufs] = w->fill;
+	w->head++;
+	w->stats.max_queued = MAX(w->stats.max_queued, w->head - w->tail);
+	pthread_cond_signal(&w->queued);
+
+	/* Backpressure: all buffers are queued, the output can't keep up */
+	if (w->head - w->tail >= w->nbufs) {
+		start = now();
+		while (w->head - w->tail >= w->nbufs) {
+			pthread_cond_wait(&w->freed, &w->lock);
+		}
+		w->stats.stalls++;
+		w->stats.stall_time += now() - start;
+	}
+	pthread_mutex_unlock(&w->lock);
+
+	w->fill = 0;
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+/* }}} */
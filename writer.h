@@ -0,0 +1,91 @@
+/**
+ * Asynchronous output writer: the demodulator fills large buffers, and a
+ * dedicated thread hands them to the kernel with writev(), so that a slow
+ * disk or a stalled pipe doesn't hold up the signal processing
+ */
+#ifndef writer_h
+#define writer_h
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define WRITER_NBUFS 8              /* Default number of output buffers */
+#define WRITER_BUFSIZE (64*1024)    /* Default size of each output buffer, in bytes */
+
+typedef struct {
+	uint64_t bytes;         /* Bytes handed to the kernel */
+	uint64_t stalls;        /* Number of times the producer waited for a free buffer */
+	double stall_time;      /* Seconds the producer spent waiting for a free buffer */
+	double write_time;      /* Seconds the writer thread spent blocked in writev() */
+	unsigned max_queued;    /* Highest number of buffers waiting to be written */
+} WriterStats;
+
+typedef struct {
+	int fd;
+	int error;
+	int closing;
+
+	uint8_t *mem;               /* nbufs buffers of bufsize bytes each */
+	size_t *len;                /* Bytes queued in each buffer */
+	unsigned nbufs;
+	size_t bufsize;
+	size_t fill;                /* Bytes in the buffer being filled */
+
+	/* Buffers [tail, head) are queued for writing, buffer head is being
+	 * filled by the producer. Both counters grow forever, wrapping around */
+	unsigned head, tail;
+	pthread_mutex_t lock;
+	pthread_cond_t queued, freed;
+	pthread_t tid;
+
+	WriterStats stats;
+} Writer;
+
+/**
+ * Initialize an output writer and start its thread
+ *
+ * @param w writer to initialize
+ * @param fd file descriptor to write to
+ * @param nbufs number of buffers, at least 2
+ * @param bufsize size of each buffer in bytes
+ * @return 0 on success, 1 on failure
+ */
+int writer_init(Writer *w, int fd, unsigned nbufs, size_t bufsize);
+
+/**
+ * Append data to the output. Only blocks if all buffers are waiting to be
+ * written. Must only be called from one thread at a time
+ *
+ * @param w writer to append to
+ * @param data data to append
+ * @param len number of bytes to append
+ */
+void writer_write(Writer *w, const void *data, size_t len);
+
+/**
+ * Queue the partially filled buffer for writing, without waiting for it to be
+ * written
+ *
+ * @param w writer to flush
+ */
+void writer_flush(Writer *w);
+
+/**
+ * Get a snapshot of the writer statistics
+ *
+ * @param w writer to query
+ * @param stats filled with the current statistics
+ */
+void writer_get_stats(Writer *w, WriterStats *stats);
+
+/**
+ * Write out all pending data, stop the writer thread and free its buffers.
+ * The file descriptor is left open
+ *
+ * @param w writer to deinitialize
+ * @return 0 on success, 1 if any write failed
+ */
+int writer_deinit(Writer *w);
+
+#endif